@@ -0,0 +1,15 @@
+#version 100
+
+precision mediump float;
+
+// Input vertex attributes (from vertex shader)
+varying vec2 fragTexCoord;
+varying vec4 fragColor;
+
+// Input uniform values
+uniform sampler2D texture0;
+
+void main()
+{
+    gl_FragColor = texture2D(texture0, fragTexCoord)*fragColor;
+}
@@ -0,0 +1,34 @@
+#version 100
+
+// Input vertex attributes
+attribute vec2 vertexCorner;        // quad corner in [-0.5, 0.5]
+
+// Per-instance attributes, one ParticleSystem column each
+attribute float instancePosX;
+attribute float instancePosY;
+attribute float instancePosZ;
+attribute float instanceSize;
+attribute float instanceAge;
+attribute float instanceLife;
+attribute vec4 instanceColor;
+
+// Input uniform values
+uniform mat4 mvp;                   // view * projection
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+
+// Output vertex attributes (to fragment shader)
+varying vec2 fragTexCoord;
+varying vec4 fragColor;
+
+void main()
+{
+    // Camera-facing quad around the particle, faded out over its life
+    vec3 center = vec3(instancePosX, instancePosY, instancePosZ);
+    vec3 position = center + (cameraRight*vertexCorner.x + cameraUp*vertexCorner.y)*instanceSize;
+
+    fragTexCoord = vec2(vertexCorner.x + 0.5, 0.5 - vertexCorner.y);
+    fragColor = vec4(instanceColor.rgb, instanceColor.a*clamp(1.0 - instanceAge/instanceLife, 0.0, 1.0));
+
+    gl_Position = mvp*vec4(position, 1.0);
+}
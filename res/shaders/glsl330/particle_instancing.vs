@@ -0,0 +1,34 @@
+#version 330
+
+// Input vertex attributes
+in vec2 vertexCorner;       // quad corner in [-0.5, 0.5]
+
+// Per-instance attributes, one ParticleSystem column each
+in float instancePosX;
+in float instancePosY;
+in float instancePosZ;
+in float instanceSize;
+in float instanceAge;
+in float instanceLife;
+in vec4 instanceColor;
+
+// Input uniform values
+uniform mat4 mvp;           // view * projection
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+
+// Output vertex attributes (to fragment shader)
+out vec2 fragTexCoord;
+out vec4 fragColor;
+
+void main()
+{
+    // Camera-facing quad around the particle, faded out over its life
+    vec3 center = vec3(instancePosX, instancePosY, instancePosZ);
+    vec3 position = center + (cameraRight*vertexCorner.x + cameraUp*vertexCorner.y)*instanceSize;
+
+    fragTexCoord = vec2(vertexCorner.x + 0.5, 0.5 - vertexCorner.y);
+    fragColor = vec4(instanceColor.rgb, instanceColor.a*clamp(1.0 - instanceAge/instanceLife, 0.0, 1.0));
+
+    gl_Position = mvp*vec4(position, 1.0);
+}
@@ -0,0 +1,211 @@
+#include "diagnostics.h"
+#include "simulation.h"
+#include "metrics_server.h"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+SystemProfiler g_systemProfiler;
+
+static const int HITCH_COOLDOWN_FRAMES = 120;
+
+FrameTimeHistogram g_frameTimes;
+static FrameTrace g_frameTrace(240);
+HitchDetector g_hitchDetector;
+static uint64_t g_frameIndex = 0;
+
+StartupTimeline g_startupTimeline;
+
+// --- Metrics export ---
+// Prometheus text for the metrics endpoint: Flecs world info and per-system figures, our own
+// frame timings, and allocator/pool counters. Built on the main thread at a low rate and handed
+// to the server thread as one string (metrics_server.h).
+std::string FormatMetrics(flecs::world& world)
+{
+    std::string text;
+    auto metric = [&](const char* name, const char* type, const char* help, double value)
+    {
+        text += std::format("# HELP {0} {1}\n# TYPE {0} {2}\n{0} {3}\n", name, help, type, value);
+    };
+
+    const ecs_world_info_t* info = ecs_get_world_info(world);
+    metric("flecs_entities", "gauge", "Alive entities", ecs_get_entities(world).alive_count);
+    metric("flecs_tables", "gauge", "Archetype tables", info->table_count);
+    metric("flecs_frames_total", "counter", "Frames progressed", static_cast<double>(info->frame_count_total));
+    metric("flecs_frame_seconds_total", "counter", "Time spent in progress()", info->frame_time_total);
+    metric("flecs_system_seconds_total", "counter", "Time spent in systems", info->system_time_total);
+    metric("flecs_merge_seconds_total", "counter", "Time spent merging deferred commands", info->merge_time_total);
+    metric("flecs_systems_ran", "gauge", "Systems run in the last frame", info->systems_ran_frame);
+
+    metric("app_frame_seconds", "gauge", "Last frame's delta time", world.delta_time());
+    text += "# HELP app_frame_ms Frame time percentiles since start\n# TYPE app_frame_ms summary\n";
+    for (double q : { 0.5, 0.99, 0.999 })
+    {
+        text += std::format("app_frame_ms{{quantile=\"{}\"}} {}\n", q, g_frameTimes.Percentile(q));
+    }
+    text += std::format("app_frame_ms_count {}\n", g_frameTimes.Count());
+    metric("app_hitches_total", "counter", "Frames over the hitch threshold that were captured", g_hitchDetector.captures);
+    if (const double firstFrameMs = g_startupTimeline.FirstFrameMs(); firstFrameMs >= 0.0)
+    {
+        metric("app_time_to_first_frame_seconds", "gauge", "Process start to the end of the first frame", firstFrameMs / 1000.0);
+    }
+    text += "# HELP app_startup_phase_seconds Duration of each startup phase\n# TYPE app_startup_phase_seconds gauge\n";
+    for (const StartupTimeline::Phase& phase : g_startupTimeline.Phases())
+    {
+        text += std::format("app_startup_phase_seconds{{phase=\"{}\",background=\"{}\"}} {}\n", phase.name, phase.background, (phase.endMs - phase.startMs) / 1000.0);
+    }
+    const SimulationState& state = GetSimulationState(world);
+    metric("app_bodies", "gauge", "Collision bodies", state.stats.bodies);
+    metric("app_contacts", "gauge", "Body pair contacts in the last frame", state.stats.contacts);
+    metric("app_kinetic_energy", "gauge", "Total kinetic energy of the bodies", state.stats.kineticEnergy);
+
+    metric("flecs_os_malloc_total", "counter", "Flecs OS API mallocs", static_cast<double>(ecs_os_api_malloc_count));
+    metric("flecs_os_calloc_total", "counter", "Flecs OS API callocs", static_cast<double>(ecs_os_api_calloc_count));
+    metric("flecs_os_realloc_total", "counter", "Flecs OS API reallocs", static_cast<double>(ecs_os_api_realloc_count));
+    metric("flecs_os_free_total", "counter", "Flecs OS API frees", static_cast<double>(ecs_os_api_free_count));
+    metric("app_pooled_entities", "gauge", "Parked entities in the entity pool", PooledEntityCount(world));
+    metric("app_particles", "gauge", "Live cosmetic particles", state.particles.Count());
+    metric("app_particles_dropped_total", "counter", "Particles dropped because the pool was full", static_cast<double>(state.particles.Dropped()));
+    metric("app_lifetimes_pending", "gauge", "Lifetimes waiting in the timing wheel", static_cast<double>(state.lifetimeWheel.PendingCount()));
+
+    // per system: time from the profiler, matches from the system's query
+    text += "# HELP flecs_system_cpu_seconds_total CPU time per system, summed over workers\n# TYPE flecs_system_cpu_seconds_total counter\n";
+    for (const SystemProfiler::SystemStats& system : g_systemProfiler.Snapshot())
+    {
+        text += std::format("flecs_system_cpu_seconds_total{{system=\"{}\"}} {}\n", system.name, system.cpuMs / 1000.0);
+    }
+
+    std::string tables;
+    text += "# HELP flecs_system_matched_entities Entities matched by the system's query\n# TYPE flecs_system_matched_entities gauge\n";
+    world.query_builder<>().with(flecs::System).build().each([&](flecs::entity e)
+    {
+        const ecs_system_t* system = ecs_system_get(world, e);
+        if (!system || !system->query)
+            return;
+
+        const ecs_query_count_t count = ecs_query_count(system->query);
+        text += std::format("flecs_system_matched_entities{{system=\"{}\"}} {}\n", e.name().c_str(), count.entities);
+        tables += std::format("flecs_system_matched_tables{{system=\"{}\"}} {}\n", e.name().c_str(), count.tables);
+    });
+    text += "# HELP flecs_system_matched_tables Tables matched by the system's query\n# TYPE flecs_system_matched_tables gauge\n";
+    text += tables;
+    return text;
+}
+
+void StartMetrics(flecs::world& world, int port)
+{
+    if (!StartMetricsServer(port))
+    {
+        SimLog(LOG_WARNING, "Metrics endpoint disabled, port %d is not available", port);
+        return;
+    }
+    ecs_measure_frame_time(world, true);
+    ecs_measure_system_time(world, true);
+}
+
+void DeclarePublishMetricsSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("PublishMetrics")
+        .kind(inPhase)
+        .tick_source(GetSimulationState(world).periodicJobs.Every(world, "MetricsTick", 1.0f))
+        .each([&]()
+        {
+            if (MetricsServerRunning())
+                PublishMetrics(FormatMetrics(world));
+        });
+}
+
+void InstallDiagnostics(flecs::world& world)
+{
+    world.import<SimCore>();
+    DeclarePublishMetricsSystem(world, world.get<SimCore>().postPhysics);
+    g_systemProfiler.Install(world);
+}
+
+// Writes the frozen trace, and optionally the world, for the frame that crossed the threshold
+void CaptureHitch(flecs::world& world, const FrameSample& hitch)
+{
+    std::error_code error;
+    std::filesystem::create_directories("hitches", error);
+    const std::string base = std::format("hitches/hitch_{}", hitch.index);
+
+    std::string json = std::format("{{\"frame\":{},\"frame_ms\":{:.3f},\"threshold_ms\":{:.1f},\"p50_ms\":{:.3f},\"p99_ms\":{:.3f},\"p999_ms\":{:.3f},\"systems\":[",
+        hitch.index, hitch.frameMs, g_hitchDetector.thresholdMs, g_frameTimes.Percentile(0.5), g_frameTimes.Percentile(0.99), g_frameTimes.Percentile(0.999));
+    const std::vector<SystemProfiler::SystemStats> systems = g_systemProfiler.Snapshot();
+    for (size_t i = 0; i < systems.size(); ++i)
+    {
+        json += std::format("{}\"{}\"", i ? "," : "", systems[i].name);
+    }
+    json += "],\"frames\":[";
+    const std::vector<FrameSample> frames = g_frameTrace.Freeze();
+    for (size_t f = 0; f < frames.size(); ++f)
+    {
+        const FrameSample& frame = frames[f];
+        json += std::format("{}{{\"index\":{},\"ms\":{:.3f},\"cell_buckets\":{},\"log_messages\":{},\"system_ms\":[", f ? "," : "",
+            frame.index, frame.frameMs, frame.cellBuckets, frame.logMessages);
+        for (size_t i = 0; i < frame.systemMs.size(); ++i)
+        {
+            json += std::format("{}{:.3f}", i ? "," : "", frame.systemMs[i]);
+        }
+        json += "]}";
+    }
+    json += "]}";
+    std::ofstream(base + "_trace.json") << json;
+
+    if (g_hitchDetector.captureWorld)
+    {
+        std::ofstream(base + "_world.json") << world.to_json().c_str();
+    }
+
+    ++g_hitchDetector.captures;
+    g_hitchDetector.lastCapture = base;
+    g_hitchDetector.cooldownFrames = HITCH_COOLDOWN_FRAMES;
+    SimLog(LOG_WARNING, "Hitch: frame %llu took %.1f ms, captured to %s_*.json", static_cast<unsigned long long>(hitch.index), hitch.frameMs, base.c_str());
+}
+
+void RecordFrame(flecs::world& world, double frameMs, size_t logMessages)
+{
+    g_systemProfiler.EndFrame();
+    g_frameTimes.Record(frameMs);
+
+    FrameSample& sample = g_frameTrace.Next();
+    sample.index = g_frameIndex++;
+    sample.frameMs = static_cast<float>(frameMs);
+    sample.systemMs.assign(g_systemProfiler.LastFrameMs().begin(), g_systemProfiler.LastFrameMs().end());
+    sample.cellBuckets = CellBucketCount(world);
+    sample.logMessages = logMessages;
+
+    if (g_hitchDetector.cooldownFrames > 0)
+    {
+        --g_hitchDetector.cooldownFrames;
+        return;
+    }
+    if (g_hitchDetector.thresholdMs > 0.0f && frameMs > g_hitchDetector.thresholdMs)
+    {
+        CaptureHitch(world, sample);
+    }
+}
+
+std::string SystemProfileJson()
+{
+    std::string json;
+    const bool counters = g_systemProfiler.CountersEnabled();
+    for (const SystemProfiler::SystemStats& system : g_systemProfiler.Snapshot())
+    {
+        if (system.runs == 0)
+            continue;
+
+        if (!json.empty()) json += ",";
+        json += std::format("{{\"name\":\"{}\",\"runs\":{},\"cpu_ms\":{:.3f}", system.name, system.runs, system.cpuMs);
+        if (counters)
+        {
+            for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter)
+            {
+                json += std::format(",\"{}\":{}", PerfCounterName(counter), system.counters[counter]);
+            }
+        }
+        json += "}";
+    }
+    return json;
+}
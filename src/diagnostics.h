@@ -0,0 +1,50 @@
+#pragma once
+
+#include "flecs.h"
+#include "system_profiler.h"
+#include "frame_timeline.h"
+
+#include <cstdint>
+#include <string>
+
+// --- Diagnostics ---
+// Per-system profiling, frame timing with hitch capture and the metrics endpoint. Part of
+// MyProjectSim, so the app, the benchmark and the tools report the same figures.
+
+// Wall time and hardware counters per Flecs system, installed by InstallDiagnostics
+extern SystemProfiler g_systemProfiler;
+
+// --- Frame timing and hitch capture ---
+// Every frame goes into a histogram (percentiles) and a rolling trace of the last frames. A frame
+// slower than the threshold freezes the trace and writes it, optionally with a world snapshot, to
+// hitches/. Opt-in (--hitch-ms N, or the GUI slider): window drags and the first frames' uploads
+// would otherwise leave files behind on every normal run.
+struct HitchDetector
+{
+    float thresholdMs = 0.0f;  // 0 disables captures
+    bool captureWorld = false; // world JSON next to the trace, large with many entities
+    int cooldownFrames = 0;    // frames ignored after a capture, the capture itself is slow
+    int captures = 0;
+    std::string lastCapture;
+};
+
+extern FrameTimeHistogram g_frameTimes;
+extern HitchDetector g_hitchDetector;
+
+// Startup phases of whichever entry point runs (the app or the headless benchmark), reported at
+// launch and exported as metrics together with the time to first frame
+extern StartupTimeline g_startupTimeline;
+
+// Declares PublishMetrics and wraps every system declared so far; call after DeclareECS
+void InstallDiagnostics(flecs::world& world);
+
+// Closes the frame for the profiler, the histogram and the trace, then checks for a hitch.
+// logMessages is the caller's running count of log lines, recorded in the trace.
+void RecordFrame(flecs::world& world, double frameMs, size_t logMessages);
+
+// Starts the metrics endpoint and turns on the Flecs time measurements it reports
+void StartMetrics(flecs::world& world, int port);
+std::string FormatMetrics(flecs::world& world);
+
+// One JSON object per system that ran, counters only when they were sampled
+std::string SystemProfileJson();
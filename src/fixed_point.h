@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cmath>
+#include <compare>
+#include <cstdint>
+
+// --- Fixed-point scalar for the collision kernels (Precision::FixedContacts).
+// 64-bit integer with 16 fractional bits, a drop-in Real for the CollisionPolicy templates: the
+// kernels gather float components into it, do all of the contact math in integer arithmetic and
+// convert back on write-back. Only the contact math is integer: Position and Velocity stay float,
+// and integration, wall bounces and collision responses are float math as in the other
+// precisions, so a run is not reproducible across compilers or platforms because of this type.
+//
+// Products and quotients split an operand so that no intermediate exceeds 64 bits: they are
+// exact (floored, truncated) wherever the result itself fits the 48.16 range, ±2^47 units.
+// Resolution is 1/65536, enough for unit normals and for the positions of a ±32768 arena.
+struct Fixed
+{
+    static constexpr int FRACTION_BITS = 16;
+    static constexpr int64_t ONE = int64_t(1) << FRACTION_BITS;
+
+    int64_t raw = 0;
+
+    constexpr Fixed() = default;
+    constexpr Fixed(int value) : raw(static_cast<int64_t>(value) * ONE) {}
+    // exact scaling by a power of two, then round to nearest
+    explicit Fixed(float value) : raw(std::llround(static_cast<double>(value) * ONE)) {}
+    explicit Fixed(double value) : raw(std::llround(value * ONE)) {}
+
+    static constexpr Fixed FromRaw(int64_t raw)
+    {
+        Fixed f;
+        f.raw = raw;
+        return f;
+    }
+
+    explicit operator float() const { return static_cast<float>(static_cast<double>(raw) / ONE); }
+    explicit operator double() const { return static_cast<double>(raw) / ONE; }
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b) { return FromRaw(a.raw + b.raw); }
+    friend constexpr Fixed operator-(Fixed a, Fixed b) { return FromRaw(a.raw - b.raw); }
+    friend constexpr Fixed operator-(Fixed a) { return FromRaw(-a.raw); }
+    // (high * 2^16 + low) * b >> 16 = high * b + (low * b >> 16), low in [0, 2^16); arithmetic
+    // shifts (defined since C++20), so products round towards -infinity
+    friend constexpr Fixed operator*(Fixed a, Fixed b)
+    {
+        const int64_t high = a.raw >> FRACTION_BITS;
+        const int64_t low = a.raw & (ONE - 1);
+        return FromRaw(high * b.raw + ((low * b.raw) >> FRACTION_BITS));
+    }
+    // (q * b + r) * 2^16 / b = q * 2^16 + r * 2^16 / b, both terms with the quotient's sign, so
+    // it truncates towards zero as the plain division would; the kernels never divide by zero
+    friend constexpr Fixed operator/(Fixed a, Fixed b)
+    {
+        const int64_t quotient = a.raw / b.raw;
+        const int64_t remainder = a.raw % b.raw;
+        return FromRaw(quotient * ONE + remainder * ONE / b.raw);
+    }
+
+    Fixed& operator+=(Fixed b) { raw += b.raw; return *this; }
+    Fixed& operator-=(Fixed b) { raw -= b.raw; return *this; }
+    Fixed& operator*=(Fixed b) { return *this = *this * b; }
+
+    friend constexpr auto operator<=>(Fixed a, Fixed b) = default;
+    friend constexpr bool operator==(Fixed a, Fixed b) = default;
+};
+
+// floor(sqrt), found by ADL next to std::sqrt. The double estimate is only a starting point,
+// the integer correction makes the result exact and platform independent. Past 2^30 units the
+// raw value can not take the fraction shift: the root of the integer part is taken instead.
+inline Fixed sqrt(Fixed x)
+{
+    if (x.raw <= 0)
+        return Fixed();
+
+    const bool shifted = x.raw < (int64_t(1) << (62 - Fixed::FRACTION_BITS));
+    const int64_t n = shifted ? x.raw * Fixed::ONE : x.raw >> Fixed::FRACTION_BITS;
+    int64_t r = static_cast<int64_t>(std::sqrt(static_cast<double>(n)));
+    while (r > 0 && r * r > n) --r;
+    while ((r + 1) * (r + 1) <= n) ++r;
+    return Fixed::FromRaw(shifted ? r : r * Fixed::ONE);
+}
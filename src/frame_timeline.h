@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// --- Frame time histogram.
+// Log-spaced buckets, BUCKETS_PER_OCTAVE per doubling from MIN_MS up to MAX_MS, so recording is
+// O(1) with no allocation and a percentile is one walk over BUCKET_COUNT counters. Percentiles
+// interpolate geometrically inside a bucket, which keeps the error under ~5%.
+class FrameTimeHistogram
+{
+public:
+    static constexpr double MIN_MS = 0.05;
+    static constexpr int BUCKETS_PER_OCTAVE = 8;
+    static constexpr int OCTAVES = 16; // up to ~3.3 s
+    static constexpr int BUCKET_COUNT = BUCKETS_PER_OCTAVE * OCTAVES + 1; // last bucket is open-ended
+
+    void Record(double ms)
+    {
+        ++counts[BucketOf(ms)];
+        ++total;
+        maxMs = std::max(maxMs, ms);
+    }
+
+    // q in [0, 1]; 0 when nothing was recorded
+    double Percentile(double q) const
+    {
+        if (total == 0)
+            return 0.0;
+
+        const double rank = q * static_cast<double>(total);
+        uint64_t seen = 0;
+        for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+        {
+            if (counts[bucket] == 0 || static_cast<double>(seen + counts[bucket]) < rank)
+            {
+                seen += counts[bucket];
+                continue;
+            }
+
+            if (bucket == BUCKET_COUNT - 1)
+                return maxMs;
+            const double within = (rank - static_cast<double>(seen)) / static_cast<double>(counts[bucket]);
+            return std::min(LowerEdge(bucket) * std::pow(2.0, within / BUCKETS_PER_OCTAVE), maxMs);
+        }
+        return maxMs;
+    }
+
+    uint64_t Count() const { return total; }
+    double Max() const { return maxMs; }
+
+    void Reset()
+    {
+        std::fill(std::begin(counts), std::end(counts), 0);
+        total = 0;
+        maxMs = 0.0;
+    }
+
+private:
+    static int BucketOf(double ms)
+    {
+        if (ms <= MIN_MS)
+            return 0;
+        const int bucket = static_cast<int>(std::log2(ms / MIN_MS) * BUCKETS_PER_OCTAVE);
+        return std::min(bucket, BUCKET_COUNT - 1);
+    }
+
+    static double LowerEdge(int bucket)
+    {
+        return MIN_MS * std::pow(2.0, static_cast<double>(bucket) / BUCKETS_PER_OCTAVE);
+    }
+
+    uint64_t counts[BUCKET_COUNT] = {};
+    uint64_t total = 0;
+    double maxMs = 0.0;
+};
+
+// One frame of the rolling trace kept for hitch captures
+struct FrameSample
+{
+    uint64_t index = 0;
+    float frameMs = 0.0f;
+    std::vector<float> systemMs; // per profiled system, in SystemProfiler order
+    size_t cellBuckets = 0;      // CellBucketCount(), a change means it rehashed
+    size_t logMessages = 0;      // log lines written so far, bursts show up as jumps
+};
+
+// --- Fixed-size ring of the last capacity frames. Samples are reused in place, so recording a
+// frame allocates nothing once the ring has wrapped.
+class FrameTrace
+{
+public:
+    explicit FrameTrace(int capacity = 240)
+        : samples(std::max(capacity, 1))
+    {
+    }
+
+    // The slot for the next frame; the caller fills it in
+    FrameSample& Next()
+    {
+        FrameSample& sample = samples[head];
+        head = (head + 1) % static_cast<int>(samples.size());
+        size = std::min(size + 1, static_cast<int>(samples.size()));
+        return sample;
+    }
+
+    // Oldest to newest
+    std::vector<FrameSample> Freeze() const
+    {
+        std::vector<FrameSample> frozen;
+        frozen.reserve(size);
+        const int capacity = static_cast<int>(samples.size());
+        for (int i = 0; i < size; ++i)
+        {
+            frozen.push_back(samples[(head - size + i + capacity) % capacity]);
+        }
+        return frozen;
+    }
+
+private:
+    std::vector<FrameSample> samples;
+    int head = 0;
+    int size = 0;
+};
+
+// --- Startup phases, from process start to the first frame.
+// Each phase keeps its own start and end relative to the origin (static initialization, close
+// to process start), so a phase that ran on a worker alongside the main thread shows up as the
+// overlap it is. Time to first frame is the end of the critical path.
+class StartupTimeline
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase
+    {
+        std::string name;
+        double startMs = 0.0;
+        double endMs = 0.0;
+        bool background = false; // ran off the main thread
+    };
+
+    // Thread-safe, background phases are recorded from their own thread
+    void Record(const char* name, Clock::time_point start, Clock::time_point end, bool background = false)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        phases.push_back({ name, Since(start), Since(end), background });
+    }
+
+    // Only the first call counts
+    void MarkFirstFrame()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (firstFrameMs < 0.0)
+            firstFrameMs = Since(Clock::now());
+    }
+
+    // < 0 until the first frame
+    double FirstFrameMs() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return firstFrameMs;
+    }
+
+    // In the order they ended
+    std::vector<Phase> Phases() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return phases;
+    }
+
+private:
+    double Since(Clock::time_point t) const
+    {
+        return std::chrono::duration<double, std::milli>(t - origin).count();
+    }
+
+    const Clock::time_point origin = Clock::now();
+    mutable std::mutex mutex;
+    std::vector<Phase> phases;
+    double firstFrameMs = -1.0;
+};
+
+// Records the enclosing scope as one startup phase
+class StartupPhase
+{
+public:
+    StartupPhase(StartupTimeline& timeline, const char* name, bool background = false)
+        : timeline(timeline), name(name), background(background), start(StartupTimeline::Clock::now())
+    {
+    }
+
+    ~StartupPhase()
+    {
+        timeline.Record(name, start, StartupTimeline::Clock::now(), background);
+    }
+
+    StartupPhase(const StartupPhase&) = delete;
+    StartupPhase& operator=(const StartupPhase&) = delete;
+
+private:
+    StartupTimeline& timeline;
+    const char* name;
+    bool background;
+    StartupTimeline::Clock::time_point start;
+};
@@ -0,0 +1,240 @@
+#include "headless.h"
+#include "diagnostics.h"
+#include "instrumentation.h"
+#include "metrics_server.h"
+#include "scenario.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <thread>
+#include <vector>
+
+LaunchOptions ParseLaunchOptions(int argc, char** argv)
+{
+    LaunchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--bench" && hasValue)
+        {
+            options.headless = true;
+            options.scene = argv[++i];
+        }
+        else if (arg == "--scene" && hasValue)
+        {
+            options.scene = argv[++i];
+        }
+        else if (arg == "--scenario" && hasValue)
+        {
+            options.scenarioPath = argv[++i];
+        }
+        else if (arg == "--count" && hasValue)
+        {
+            options.entityCount = std::max(std::atoi(argv[++i]), 0);
+        }
+        else if (arg == "--frames" && hasValue)
+        {
+            options.frames = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "--threads" && hasValue)
+        {
+            options.threads = std::max(std::atoi(argv[++i]), 0);
+        }
+        else if (arg == "--solver" && hasValue)
+        {
+            options.solver = std::string(argv[++i]) == "impulse" ? CollisionSolver::SequentialImpulse : CollisionSolver::OneShot;
+        }
+        else if (arg == "--broadphase" && hasValue)
+        {
+            options.broadphase = std::string(argv[++i]) == "grid" ? BroadphaseKind::SortedGrid : BroadphaseKind::HashBuckets;
+        }
+        else if (arg == "--precision" && hasValue)
+        {
+            const std::string precision = argv[++i];
+            options.precision = precision == "double" ? Precision::Double : (precision == "fixed-contacts" ? Precision::FixedContacts : Precision::Float);
+        }
+        else if (arg == "--dim" && hasValue)
+        {
+            options.dimensions = std::atoi(argv[++i]) == 3 ? 3 : 2;
+        }
+        else if (arg == "--deterministic")
+        {
+            options.deterministic = true;
+        }
+        else if (arg == "--perf-counters")
+        {
+            options.perfCounters = true;
+        }
+        else if (arg == "--metrics-port" && hasValue)
+        {
+            options.metricsPort = std::max(std::atoi(argv[++i]), 0);
+        }
+        else if (arg == "--hitch-ms" && hasValue)
+        {
+            options.hitchMs = std::max(static_cast<float>(std::atof(argv[++i])), 0.0f);
+        }
+        else
+        {
+            fprintf(stderr, "Ignoring unknown argument '%s'\n", arg.c_str());
+        }
+    }
+    return options;
+}
+
+static std::atomic<size_t> g_headlessLogMessages{ 0 };
+
+// Benchmark output goes to stdout as JSON, so logs go to stderr
+static void HeadlessLog(int msgType, const char* text, va_list args)
+{
+    ++g_headlessLogMessages;
+    if (msgType < LOG_WARNING)
+        return;
+
+    fprintf(stderr, "%s ", GetLogMsgTypeAsString(msgType));
+    vfprintf(stderr, text, args);
+    fprintf(stderr, "\n");
+}
+
+int RunHeadlessBenchmark(const LaunchOptions& options)
+{
+    SetSimLogCallback(HeadlessLog);
+
+    flecs::world* world = nullptr;
+    const int threads = options.threads > 0 ? options.threads : static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    {
+        StartupPhase phase(g_startupTimeline, "CreateWorld");
+        world = CreateSimulationWorld();
+        SetSimulationThreads(*world, threads);
+    }
+    {
+        StartupPhase phase(g_startupTimeline, "DeclareECS");
+        DeclareECS(*world);
+        InstallDiagnostics(*world);
+    }
+
+    if (options.metricsPort > 0)
+    {
+        StartMetrics(*world, options.metricsPort);
+    }
+
+    // captures write files, which would end up in the timings unless asked for
+    g_hitchDetector.thresholdMs = std::max(options.hitchMs, 0.0f);
+
+    if (options.perfCounters)
+    {
+        g_systemProfiler.SetCountersEnabled(true);
+        if (!g_systemProfiler.CountersEnabled())
+        {
+            SimLog(LOG_WARNING, "Hardware counters unavailable (%s), timing systems only", g_systemProfiler.CountersUnavailableReason().c_str());
+        }
+    }
+
+    {
+        GameState& game_state = world->ensure<GameState>();
+        game_state.collisionSolver = options.solver;
+        game_state.broadphase = options.broadphase;
+        game_state.precision = options.precision;
+        game_state.dimensions = options.dimensions;
+        game_state.deterministic = options.deterministic;
+    }
+
+    std::string sceneName = options.scene;
+    int frames = options.frames;
+    ChurnScene churn;
+    const bool churning = options.scenarioPath.empty() && options.scene == "churn";
+    const StartupTimeline::Clock::time_point spawnStart = StartupTimeline::Clock::now();
+    if (!options.scenarioPath.empty())
+    {
+        Scenario scenario;
+        std::string error;
+        if (!LoadScenario(options.scenarioPath, scenario, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            delete world;
+            return 1;
+        }
+        SpawnScenario(*world, scenario);
+        sceneName = scenario.name;
+        frames = scenario.frames > 0 ? scenario.frames : options.frames;
+    }
+    else if (StressPattern pattern; ParseStressPattern(options.scene, pattern))
+    {
+        SpawnScenario(*world, MakeStressScenario(pattern, options.entityCount));
+    }
+    else if (churning)
+    {
+        churn = SetupChurnScene(*world, options.entityCount, options.frames);
+    }
+    else if (options.scene == "fluid")
+    {
+        SpawnFluidScene(*world, options.entityCount);
+    }
+    else if (options.scene == "bounce")
+    {
+        SpawnBounceScene(*world, options.entityCount);
+    }
+    else
+    {
+        fprintf(stderr, "Unknown benchmark scene '%s'\n", options.scene.c_str());
+        delete world;
+        return 1;
+    }
+    g_startupTimeline.Record("SpawnScene", spawnStart, StartupTimeline::Clock::now());
+
+    // fixed 60 Hz step so runs are comparable regardless of how long a frame takes
+    const float timeStep = 1.0f / 60.0f;
+    std::vector<double> frameMs;
+    frameMs.reserve(frames);
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (churning)
+        {
+            SpawnChurnWave(*world, churn); // spawn cost is part of the frame
+        }
+        world->progress(timeStep);
+        INSTRUMENT_FRAME_MARK;
+        const auto end = std::chrono::steady_clock::now();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        RecordFrame(*world, frameMs.back(), g_headlessLogMessages);
+        g_startupTimeline.MarkFirstFrame();
+    }
+
+    std::string startup;
+    for (const StartupTimeline::Phase& phase : g_startupTimeline.Phases())
+    {
+        startup += std::format("{}\"{}\":{:.3f}", startup.empty() ? "" : ",", phase.name, phase.endMs - phase.startMs);
+    }
+
+    double total = 0.0;
+    for (double ms : frameMs) total += ms;
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    const auto percentile = [&](double q) { return sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * q))]; };
+    const double p50 = percentile(0.5);
+    const double p99 = percentile(0.99);
+    const double p999 = percentile(0.999);
+    const FrameStats& stats = GetSimulationState(*world).stats;
+
+    printf("%s\n", std::format(
+        "{{\"scene\":\"{}\",\"time_to_first_frame_ms\":{:.3f},\"startup_ms\":{{{}}},\"solver\":\"{}\",\"broadphase\":\"{}\",\"precision\":\"{}\",\"dimensions\":{},\"deterministic\":{},\"entities\":{},\"pooled\":{},\"spawned\":{},\"frames\":{},\"threads\":{},\"total_ms\":{:.3f},\"avg_ms\":{:.3f},\"min_ms\":{:.3f},\"max_ms\":{:.3f},\"p50_ms\":{:.3f},\"p99_ms\":{:.3f},\"p999_ms\":{:.3f},\"hitches\":{},\"bodies\":{},\"contacts\":{},\"kinetic_energy\":{:.6g},\"momentum\":[{:.6g},{:.6g},{:.6g}],\"max_speed\":{:.3f},\"occupied_cells\":{},\"max_per_cell\":{},\"perf_counters\":\"{}\",\"systems\":[{}]}}",
+        sceneName, g_startupTimeline.FirstFrameMs(), startup,
+        options.solver == CollisionSolver::SequentialImpulse ? "impulse" : "oneshot",
+        options.broadphase == BroadphaseKind::SortedGrid ? "grid" : "hash",
+        options.precision == Precision::Double ? "double" : (options.precision == Precision::FixedContacts ? "fixed-contacts" : "float"),
+        options.dimensions, options.deterministic, world->count<Position>() - PooledEntityCount(*world), PooledEntityCount(*world), churn.spawned, frames, threads,
+        total, total / frameMs.size(), sorted.front(), sorted.back(), p50, p99, p999, g_hitchDetector.captures,
+        stats.bodies, stats.contacts, stats.kineticEnergy, stats.momentum.x, stats.momentum.y, stats.momentum.z, stats.maxSpeed,
+        stats.occupancy.occupiedCells, stats.occupancy.maxPerCell,
+        g_systemProfiler.CountersEnabled() ? "on" : (options.perfCounters ? g_systemProfiler.CountersUnavailableReason() : std::string("off")),
+        SystemProfileJson()).c_str());
+
+    StopMetricsServer();
+    delete world;
+    return 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <string>
+
+// --- Headless benchmark ---
+// MyProject --bench <bounce|fluid|churn|cell|lattice|blob> [--count N] [--frames N] [--threads N]
+//           [--solver oneshot|impulse] [--broadphase hash|grid] [--precision float|double|fixed] [--dim 2|3]
+//           [--perf-counters] [--metrics-port N] [--hitch-ms N] [--scenario file.json] [--deterministic]
+// MyProjectBench takes the same options, with --scene instead of --bench
+// --metrics-port also works without --bench, for soak tests of the windowed app
+// cell, lattice and blob are the broadphase stress patterns (scenario.h); cell is O(n^2), keep
+// --count small
+// --scenario replaces the scene and --count with a scenario file (scenario.h), in both modes
+struct LaunchOptions
+{
+    bool headless = false;
+    std::string scene = "fluid";
+    std::string scenarioPath;
+    int entityCount = 200000;
+    int frames = 600;
+    int threads = 0; // 0 = one per hardware thread
+
+    // collision variant for the bounce scene, see CollisionPolicy
+    CollisionSolver solver = CollisionSolver::OneShot;
+    BroadphaseKind broadphase = BroadphaseKind::HashBuckets;
+    Precision precision = Precision::Float;
+    int dimensions = 2;
+    bool deterministic = false; // see GameState::deterministic
+
+    bool perfCounters = false; // hardware counters per system in the JSON, see SystemProfiler
+    int metricsPort = 0;       // 0 = no metrics endpoint
+    float hitchMs = -1.0f;     // hitch capture threshold, < 0 = not given (captures off)
+};
+
+LaunchOptions ParseLaunchOptions(int argc, char** argv);
+
+// Runs options.scene for options.frames fixed steps and prints the JSON report to stdout
+int RunHeadlessBenchmark(const LaunchOptions& options);
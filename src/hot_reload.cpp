@@ -0,0 +1,165 @@
+#include "hot_reload.h"
+#include "diagnostics.h"
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// $<TARGET_FILE:MyProjectPhysics>, set by CMake
+#ifndef PHYSICS_MODULE_PATH
+#error "PHYSICS_MODULE_PATH must name the MyProjectPhysics module"
+#endif
+
+typedef void (*HotDeclarePhysicsSystemsFn)(flecs::world& world, const SimCore& core);
+
+struct PhysicsModule
+{
+    void* handle = nullptr;
+    HotDeclarePhysicsSystemsFn declare = nullptr;
+    std::filesystem::path copy; // the file dlopen mapped, removed when the module is closed
+};
+
+static PhysicsModule g_physicsModule;
+static std::filesystem::file_time_type g_loadedWriteTime;  // of the build the module was copied from
+static std::filesystem::file_time_type g_changedWriteTime; // a newer build seen on the last poll
+static std::chrono::steady_clock::time_point g_nextPoll;
+static int g_loadCount = 0;   // names the copies
+static int g_reloadCount = 0;
+
+static const std::chrono::milliseconds MODULE_POLL_INTERVAL(250);
+
+// Each load maps a copy of its own: dlopen hands back the open handle for a path it already
+// has loaded, and a rebuild must not write into a file that is mapped
+static bool LoadPhysicsModule(PhysicsModule& module)
+{
+    const std::filesystem::path source = PHYSICS_MODULE_PATH;
+    std::error_code error;
+    module.copy = std::filesystem::temp_directory_path(error)
+        / std::format("{}-{}-{}{}", source.stem().string(), getpid(), g_loadCount++, source.extension().string());
+    std::filesystem::copy_file(source, module.copy, std::filesystem::copy_options::overwrite_existing, error);
+    if (error)
+    {
+        SimLog(LOG_ERROR, "Physics module: cannot copy %s: %s", source.string().c_str(), error.message().c_str());
+        return false;
+    }
+
+    module.handle = dlopen(module.copy.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!module.handle)
+    {
+        SimLog(LOG_ERROR, "Physics module: %s", dlerror());
+        std::filesystem::remove(module.copy, error);
+        return false;
+    }
+
+    module.declare = reinterpret_cast<HotDeclarePhysicsSystemsFn>(dlsym(module.handle, "HotDeclarePhysicsSystems"));
+    if (!module.declare)
+    {
+        SimLog(LOG_ERROR, "Physics module: %s has no HotDeclarePhysicsSystems", source.string().c_str());
+        dlclose(module.handle);
+        std::filesystem::remove(module.copy, error);
+        module = {};
+        return false;
+    }
+    return true;
+}
+
+static void ClosePhysicsModule(PhysicsModule& module)
+{
+    if (module.handle)
+        dlclose(module.handle);
+
+    std::error_code ignored;
+    std::filesystem::remove(module.copy, ignored);
+    module = {};
+}
+
+static bool InModule(const void* code, const Dl_info& module)
+{
+    Dl_info info;
+    return code && dladdr(code, &info) && info.dli_fbase == module.dli_fbase;
+}
+
+// Systems the new code did not declare again still run the old module's callbacks. Deleted
+// while that module is loaded, since deleting frees their binding contexts through its code.
+// A profiled system runs ProfiledRun, the profiler knows the run callback behind it.
+static void DeleteSystemsOfModule(flecs::world& world, const PhysicsModule& module)
+{
+    Dl_info moduleInfo;
+    if (!module.handle || !dladdr(reinterpret_cast<const void*>(module.declare), &moduleInfo))
+        return;
+
+    std::vector<flecs::entity> stale;
+    world.entity<Physics>().children([&](flecs::entity child)
+    {
+        const ecs_system_t* system = ecs_system_get(world, child);
+        if (system && (InModule(reinterpret_cast<const void*>(g_systemProfiler.RunOf(world, child)), moduleInfo) || InModule(reinterpret_cast<const void*>(system->action), moduleInfo)))
+            stale.push_back(child);
+    });
+
+    for (flecs::entity system : stale)
+    {
+        SimLog(LOG_INFO, "Physics module: %s is no longer declared, deleted", system.name().c_str());
+        system.destruct();
+    }
+}
+
+void DeclareHotReloadedPhysicsSystems(flecs::world& world, const SimCore& core)
+{
+    std::error_code error;
+    g_loadedWriteTime = std::filesystem::last_write_time(PHYSICS_MODULE_PATH, error);
+    if (!LoadPhysicsModule(g_physicsModule))
+    {
+        SimLog(LOG_ERROR, "Physics module not loaded, the Physics systems are missing");
+        return;
+    }
+
+    g_physicsModule.declare(world, core);
+    SimLog(LOG_INFO, "Physics module loaded from %s", PHYSICS_MODULE_PATH);
+}
+
+bool PollPhysicsModule(flecs::world& world)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now < g_nextPoll)
+        return false;
+    g_nextPoll = now + MODULE_POLL_INTERVAL;
+
+    std::error_code error;
+    const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(PHYSICS_MODULE_PATH, error);
+    if (error || writeTime == g_loadedWriteTime)
+        return false;
+
+    // the linker writes the file over a while; load it once it stayed unchanged for a whole poll
+    if (writeTime != g_changedWriteTime)
+    {
+        g_changedWriteTime = writeTime;
+        return false;
+    }
+    g_loadedWriteTime = writeTime; // a build that fails to load is not retried
+
+    PhysicsModule next;
+    if (!LoadPhysicsModule(next))
+        return false;
+
+    // Declared in the module's scope, as the Physics constructor does: existing systems are found
+    // by name and only get the new callbacks, their old binding contexts are freed by the old code
+    const SimCore& core = world.get<SimCore>();
+    const flecs::entity_t scope = world.set_scope(world.entity<Physics>());
+    next.declare(world, core);
+    world.set_scope(scope);
+
+    DeleteSystemsOfModule(world, g_physicsModule);
+    g_systemProfiler.Refresh(world); // its slots still call the old callbacks
+    ClosePhysicsModule(g_physicsModule);
+    g_physicsModule = next;
+
+    ApplySimulationMode(world); // a system new in this build starts enabled
+    SimLog(LOG_INFO, "Physics module reloaded (%d)", ++g_reloadCount);
+    return true;
+}
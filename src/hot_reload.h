@@ -0,0 +1,25 @@
+#pragma once
+
+#include "simulation.h"
+
+// --- Hot reload of the Physics systems (cmake -DENABLE_HOT_RELOAD=ON, Linux and macOS) ---
+// The app is built without src/physics.cpp, which becomes the MyProjectPhysics module instead,
+// and the Physics module declares its systems from there. PollPhysicsModule() watches the module
+// file; once a rebuild has finished writing it, a copy is loaded and every Physics system is
+// declared again in place: same entities, so the same pipeline order, enable state and tick
+// sources, only the callbacks change. The world, the scene and the GUI settings stay as they are.
+//
+//     cmake --build <build dir> --target MyProjectPhysics   (while the app runs)
+//
+// Only what physics.cpp compiles is reloaded. Headers, simulation.cpp and anything else the app
+// links need a restart, and so does a changed system signature: an existing system keeps the
+// query it was created with. Systems the new code no longer declares are deleted; new ones run
+// after the existing systems of their phase until the next restart. The system profiler's
+// wrappers are refreshed with the new callbacks (SystemProfiler::Refresh).
+
+// Declares the Physics systems from the loaded module, loading it first. Called by the Physics
+// module constructor in place of DeclarePhysicsSystems.
+void DeclareHotReloadedPhysicsSystems(flecs::world& world, const SimCore& core);
+
+// Between frames only, never while the world progresses. True when the systems were reloaded.
+bool PollPhysicsModule(flecs::world& world);
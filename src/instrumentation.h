@@ -0,0 +1,140 @@
+#pragma once
+
+#include <mutex>
+
+// --- Tracy instrumentation, compiled out unless the build defines TRACY_ENABLE
+// (cmake -DENABLE_TRACY=ON links TracyClient, which defines it). Every macro below expands to
+// nothing, and InstrumentedMutex to a plain std::mutex, in a normal build.
+//
+//   INSTRUMENT_ZONE("Name")          scoped zone with a literal name
+//   INSTRUMENT_ZONE_TEXT(str, size)  scoped zone named at runtime (Flecs system names)
+//   INSTRUMENT_FRAME_MARK            end of a frame
+//   INSTRUMENT_THREAD_NAME("Name")   names the calling thread in the capture
+//   INSTRUMENTED_MUTEX(name)         declares a std::mutex that shows up as a lock
+//
+// Define INSTRUMENTATION_IMPLEMENTATION in exactly one translation unit before including this
+// header: with Tracy enabled that unit routes global new/delete and the Flecs allocator through
+// the memory profiler.
+
+#if defined(TRACY_ENABLE)
+
+#include <tracy/Tracy.hpp>
+
+#define INSTRUMENT_ZONE(name) ZoneScopedN(name)
+#define INSTRUMENT_ZONE_TEXT(text, size) ZoneScoped; ZoneName(text, size)
+#define INSTRUMENT_FRAME_MARK FrameMark
+#define INSTRUMENT_THREAD_NAME(name) tracy::SetThreadName(name)
+#define INSTRUMENTED_MUTEX(name) TracyLockable(std::mutex, name)
+using InstrumentedMutex = LockableBase(std::mutex);
+
+#else
+
+#define INSTRUMENT_ZONE(name)
+#define INSTRUMENT_ZONE_TEXT(text, size)
+#define INSTRUMENT_FRAME_MARK
+#define INSTRUMENT_THREAD_NAME(name)
+#define INSTRUMENTED_MUTEX(name) std::mutex name
+using InstrumentedMutex = std::mutex;
+
+#endif
+
+// Hooks the Flecs OS API allocator into the memory profiler; call before the world is created
+void InstrumentFlecsAllocations();
+
+#if defined(INSTRUMENTATION_IMPLEMENTATION)
+
+#if defined(TRACY_ENABLE)
+
+#include <cstdlib>
+#include <new>
+
+#include "flecs.h"
+
+void* operator new(std::size_t size)
+{
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    TracyAlloc(ptr, size);
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    TracyFree(ptr);
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+static const char* const FLECS_MEMORY_POOL = "flecs";
+static ecs_os_api_malloc_t g_flecsMalloc;
+static ecs_os_api_free_t g_flecsFree;
+static ecs_os_api_realloc_t g_flecsRealloc;
+static ecs_os_api_calloc_t g_flecsCalloc;
+
+void InstrumentFlecsAllocations()
+{
+    ecs_os_set_api_defaults();
+    ecs_os_api_t api = ecs_os_api;
+    g_flecsMalloc = api.malloc_;
+    g_flecsFree = api.free_;
+    g_flecsRealloc = api.realloc_;
+    g_flecsCalloc = api.calloc_;
+
+    api.malloc_ = [](ecs_size_t size) -> void*
+    {
+        void* ptr = g_flecsMalloc(size);
+        TracyAllocN(ptr, size, FLECS_MEMORY_POOL);
+        return ptr;
+    };
+    api.calloc_ = [](ecs_size_t size) -> void*
+    {
+        void* ptr = g_flecsCalloc(size);
+        TracyAllocN(ptr, size, FLECS_MEMORY_POOL);
+        return ptr;
+    };
+    api.realloc_ = [](void* old, ecs_size_t size) -> void*
+    {
+        if (old)
+            TracyFreeN(old, FLECS_MEMORY_POOL);
+        void* ptr = g_flecsRealloc(old, size);
+        TracyAllocN(ptr, size, FLECS_MEMORY_POOL);
+        return ptr;
+    };
+    api.free_ = [](void* ptr)
+    {
+        if (ptr)
+            TracyFreeN(ptr, FLECS_MEMORY_POOL);
+        g_flecsFree(ptr);
+    };
+    ecs_os_set_api(&api);
+}
+
+#else
+
+void InstrumentFlecsAllocations()
+{
+}
+
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "instrumentation.h"
+
+// --- Persistent worker pool for data-parallel loops that are not plain entity iterations
+// (contact batches, per-thread partials). Flecs' own workers only split system queries, so
+// anything indexed by contact or by slot goes through here. The calling thread takes part
+// in every ParallelFor, so a pool of N threads spawns N - 1 workers.
+class JobPool
+{
+public:
+    explicit JobPool(int threadCount = 1)
+    {
+        SetThreadCount(threadCount);
+    }
+
+    ~JobPool()
+    {
+        StopWorkers();
+    }
+
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    void SetThreadCount(int threadCount)
+    {
+        threadCount = std::max(threadCount, 1);
+        if (threadCount == GetThreadCount())
+            return;
+
+        StopWorkers();
+        stopping = false;
+        for (int i = 1; i < threadCount; ++i)
+        {
+            workers.emplace_back([this, i, startGeneration = generation] { WorkerLoop(i, startGeneration); });
+        }
+    }
+
+    int GetThreadCount() const
+    {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    // Splits [0, count) into chunks of at least minChunk items and calls fn(begin, end) or
+    // fn(begin, end, threadIndex) for each, returning once every chunk is done. threadIndex is
+    // in [0, GetThreadCount()) and is stable for the duration of the call, so it can index
+    // per-thread scratch data.
+    template<typename Fn>
+    void ParallelFor(int count, int minChunk, Fn&& fn)
+    {
+        if (count <= 0)
+            return;
+
+        const int participants = GetThreadCount();
+        const int chunk = std::max(std::max(minChunk, 1), (count + participants * 4 - 1) / (participants * 4));
+        if (participants == 1 || count <= chunk)
+        {
+            Invoke(fn, 0, count, 0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = [&fn](int begin, int end, int threadIndex) { Invoke(fn, begin, end, threadIndex); };
+            taskCount = count;
+            taskChunk = chunk;
+            nextIndex = 0;
+            activeWorkers = static_cast<int>(workers.size());
+            ++generation;
+        }
+        wakeCondition.notify_all();
+
+        RunChunks(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+        task = nullptr;
+    }
+
+private:
+    template<typename Fn>
+    static void Invoke(Fn& fn, int begin, int end, int threadIndex)
+    {
+        if constexpr (std::is_invocable_v<Fn&, int, int, int>)
+        {
+            fn(begin, end, threadIndex);
+        }
+        else
+        {
+            fn(begin, end);
+        }
+    }
+
+    void RunChunks(int threadIndex)
+    {
+        INSTRUMENT_ZONE("JobPool::RunChunks");
+        for (;;)
+        {
+            const int begin = nextIndex.fetch_add(taskChunk);
+            if (begin >= taskCount)
+                break;
+            task(begin, std::min(begin + taskChunk, taskCount), threadIndex);
+        }
+    }
+
+    void WorkerLoop(int threadIndex, unsigned long long seenGeneration)
+    {
+        INSTRUMENT_THREAD_NAME("JobPool worker");
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping)
+                    return;
+                seenGeneration = generation;
+            }
+
+            RunChunks(threadIndex);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--activeWorkers == 0)
+            {
+                doneCondition.notify_one();
+            }
+        }
+    }
+
+    void StopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    bool stopping = false;
+    unsigned long long generation = 0;
+    int activeWorkers = 0;
+
+    std::function<void(int, int, int)> task;
+    int taskCount = 0;
+    int taskChunk = 1;
+    std::atomic<int> nextIndex{ 0 };
+};
@@ -1,13 +1,14 @@
 #include "flecs.h"
 #include <vector>
-#include <random>
 #include <chrono>
 #include <iostream>
 #include <string>
 #include <mutex>
-#include <unordered_map>
-#include <cstdint>
-#include <cmath>
+#include <format>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <future>
 
 //I have removed the #define RAYGUI_IMPLEMENTATION line.This ensures that the implementation is only compiled once in the raygui_impl.cpp file that CMake generates, which will resolve the linker error.
 //#define RAYGUI_IMPLEMENTATION
@@ -17,6 +18,17 @@
 
 #define RLIGHTS_IMPLEMENTATION
 #include "./rlights.h"
+#include "instrumentation.h"
+#include "simulation.h" // components, systems and spawning, from the MyProjectSim library
+#include "diagnostics.h"
+#include "headless.h"
+#include "scenario.h"
+#include "metrics_server.h"
+#include "mesh_cache.h"
+#include "particle_renderer.h"
+#ifdef PHYSICS_HOT_RELOAD
+#include "hot_reload.h"
+#endif
 #include "../out/build/x64-Debug/_deps/raylib-build/raylib/include/rlgl.h"
 #include "../out/build/x64-Debug/_deps/raylib-src/src/external/glfw/deps/glad/vulkan.h"
 
@@ -30,23 +42,11 @@
 
 // --- Log Buffer ---
 static std::vector<std::string> logMessages;
-static std::mutex logMutex;
+static INSTRUMENTED_MUTEX(logMutex);
 static const int MAX_LOG_MESSAGES = 100;
+static size_t logMessagesTotal = 0; // including the ones already dropped from logMessages
 
 
-const char* GetLogMsgTypeAsString(int msgType)
-{
-    switch (msgType)
-    {
-        case LOG_INFO: return "[INFO]";
-        case LOG_ERROR: return "[ERROR]";
-        case LOG_WARNING: return "[WARN]";
-        case LOG_DEBUG: return "[DEBUG]";
-        default: return "";  break;
-    }
-    return "";
-}
-
 // Custom logging function
 void CustomLog(int msgType, const char* text, va_list args)
 {
@@ -56,12 +56,13 @@ void CustomLog(int msgType, const char* text, va_list args)
     const auto now = std::chrono::system_clock::now();
     std::string formatted_message = std::format("[{:%H:%M:%S}] {} {}", now, GetLogMsgTypeAsString(msgType), buffer);
 
-    std::lock_guard<std::mutex> lock(logMutex);
+    std::lock_guard<InstrumentedMutex> lock(logMutex);
     if (logMessages.size() >= MAX_LOG_MESSAGES)
     {
         logMessages.erase(logMessages.begin());
     }
     logMessages.push_back(formatted_message);
+    ++logMessagesTotal;
 }
 
 
@@ -73,15 +74,6 @@ const int INITIAL_ENTITY_COUNT = 10;
 
 
 
-struct GameState
-{
-    bool renderEntities = true;
-    float gridSize = 250.0f;
-	float entitySize = 10.0f;
-	float entitySpeed = 1500.0f;
-};
-
-
 struct RenderingData
 {
     Mesh cube;
@@ -97,6 +89,21 @@ struct RenderingData
 
     int locInstanceCount = -1;
     int locInstanceColors = -1;
+
+    Texture2D sparkTexture = { 0 };
+    ParticleRenderer particles;
+};
+
+// CPU side of the rendering data, prepared on a worker while the world is set up (see
+// PrepareRenderAssets); InitRenderingData does the GL part on the main thread
+struct RenderAssets
+{
+    char* instancingVs = nullptr; // shader sources, nullptr = raylib's default shader
+    char* lightingFs = nullptr;
+    char* particleVs = nullptr;
+    char* particleFs = nullptr;
+    CachedMesh sphere;            // mapped from the mesh cache or generated, not uploaded yet
+    Image spark = { 0 };
 };
 
 
@@ -107,8 +114,10 @@ struct MyProjectGuiState
 {
 	int entityCountSpinnerValue = 1;
 	//bool entityCountSpinnerEditMode = false;
-	Rectangle windowBoxRect = { (float)SCREEN_WIDTH - 220, 20, 200, 360 };
+	Rectangle windowBoxRect = { (float)SCREEN_WIDTH - 220, 20, 200, 540 };
     int activeTab = 0;
+    int stressPattern = 0; // StressPattern
+    int stressCount = 2000;
 };
 
 
@@ -124,58 +133,6 @@ struct GameData
 	//MyProjectGuiState projectGuiState;
 };
 
-// --- Spatial grid cell index for broadphase collision
-struct SpatialCell { int cellX; int cellY; };
-
-// --- Buckets for entities per spatial cell (rebuilt every frame)
-static std::unordered_map<long long, std::vector<flecs::entity>> g_cellBuckets;
-
-static inline long long CellKey(int x, int y)
-{
-    return (static_cast<long long>(x) << 32) ^ static_cast<unsigned long long>(y);
-}
-
-static inline std::pair<int, int> ComputeCell(const Vector3& p, float cellSize)
-{
-    const int cx = static_cast<int>(std::floor(p.x / cellSize));
-    const int cy = static_cast<int>(std::floor(p.y / cellSize));
-    return { cx, cy };
-}
-
-
-flecs::query<const GameState> get_game_state_query(const flecs::world& world)
-{
-	return world.query_builder<const GameState>()
-		.term_at(1)
-		//.singleton()
-		.cache_kind(flecs::QueryCacheAuto)
-		.build();
-}
-
-flecs::query<GameState> get_game_state_update_query(const flecs::world& world)
-{
-	return world.query_builder<GameState>()
-        .term_at(1)
-        //.singleton()
-        .build();
-}
-
-// --- Components ---
-struct Position { Vector3 value; };
-struct Velocity { Vector3 value; };
-struct ColorComp
-{
-    Color value;
-};
-
-// Accumulated collision response to apply after broadphase/border checks
-struct CollisionResponse
-{
-    Vector3 posDelta{ 0, 0, 0 };
-    Vector3 velDelta{ 0, 0, 0 };
-    bool hasCollision{ false };
-};
-
 // --- UI State ---
 struct UIState
 {
@@ -183,25 +140,6 @@ struct UIState
     struct nk_font_atlas* atlas;
 };
 
-// --- Helper Functions ---
-float GetRandomFloat(float min, float max)
-{
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(min, max);
-    return dis(gen);
-}
-
-Color GetRandomColor()
-{
-    return {
-        (unsigned char)GetRandomValue(50, 255),
-        (unsigned char)GetRandomValue(50, 255),
-        (unsigned char)GetRandomValue(50, 255),
-        255
-    };
-}
-
 void DrawXYGrid(int slices, float spacing)
 {
     int halfSlices = slices / 2;
@@ -220,58 +158,12 @@ void DrawXYGrid(int slices, float spacing)
     }
 }
 
-// --- Entity Management Function ---
-void CreateEntity(flecs::world& world)
-{
-    Vector3 newPos;
-    bool positionIsValid;
-    int maxRetries = 100;
-    int retries = 0;
-
-    const GameState& game_state = world.get<GameState>();
-
-
-    do
-    {
-        positionIsValid = true;
-        newPos =
-        {
-            GetRandomFloat(-game_state.gridSize + game_state.entitySize, game_state.gridSize - game_state.entitySize),
-            GetRandomFloat(-game_state.gridSize + game_state.entitySize, game_state.gridSize - game_state.entitySize),
-            0.0f
-        };
-        world.each([&](flecs::entity existing_entity, const Position& existing_pos)
-            {
-                if (Vector3Distance(newPos, existing_pos.value) < game_state.entitySize * 2.0f)
-                {
-                    positionIsValid = false;
-                }
-            });
-        retries++;
-    } while (!positionIsValid && retries < maxRetries);
-
-    if (!positionIsValid)
-    {
-        TraceLog(LOG_WARNING, "Failed to find a valid position for new entity after %d retries.", maxRetries);
-        return; // Failed to find a spot
-    }
-
-    Vector3 randomVelocity = { GetRandomFloat(-1.0f, 1.0f), GetRandomFloat(-1.0f, 1.0f), 0.0f };
-
-    auto new_entity = world.entity()
-        .set<Position>({ newPos })
-        .set<Velocity>({ Vector3Scale(Vector3Normalize(randomVelocity), game_state.entitySpeed) })
-        .set<ColorComp>({ GetRandomColor() })
-        .set<SpatialCell>({ 0, 0 })
-        .set<CollisionResponse>({ Vector3Zero(), Vector3Zero(), false });
-
-    TraceLog(LOG_INFO, "Created entity %s", new_entity.name().c_str());
-}
-
 #define MYARRAYSIZE(x) (sizeof((x)) / sizeof((x)[0]))
 
 void DrawGUI(MyProjectGuiState& guiState, flecs::world& world)
 {
+    INSTRUMENT_ZONE("DrawGUI");
+    const SimulationState& sim = GetSimulationState(world);
     // --- Draw GUI ---
     if (GuiWindowBox(guiState.windowBoxRect, "Entity Controls"))
     {
@@ -281,14 +173,14 @@ void DrawGUI(MyProjectGuiState& guiState, flecs::world& world)
 
     //static const char* TabNames[] = { "Tab1","Tab2", "Tab3" };
     yOffset += 30.f;
-    int TabBarResult = GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 40, 25 }, "Tab1;Tab2;Tab3;Tab4", &guiState.activeTab);
+    int TabBarResult = GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 29, 25 }, "Tab1;Tab2;Tab3;Tab4;Stats;Prof", &guiState.activeTab);
     if (guiState.activeTab == 0)
     {
         // Get a mutable reference to the GameState singleton
         GameState& game_state = world.ensure<GameState>();
 
         yOffset += 60.f;
-        GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 120, 25 }, TextFormat("Total Entities: %d", world.count<Position>()));
+        GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Total Entities: %d (pooled %d)", sim.sceneCounts.entities, sim.sceneCounts.pooled));
 
         yOffset += 30.f;
 	    int newCount = GuiSpinner({ guiState.windowBoxRect.x + 10, yOffset, 120, 25 }, "Add/Remove", &guiState.entityCountSpinnerValue, 1, 100, false);
@@ -337,8 +229,8 @@ void DrawGUI(MyProjectGuiState& guiState, flecs::world& world)
 
             if (toDelete.is_valid() && toDelete.is_alive())
 		    {
-                TraceLog(LOG_INFO, "Deleting entity %s", toDelete.name().c_str());
-			    toDelete.destruct();
+                TraceLog(LOG_INFO, "Releasing entity %s", toDelete.name().c_str());
+			    ReleaseEntity(toDelete);
             }
         }
 
@@ -346,7 +238,15 @@ void DrawGUI(MyProjectGuiState& guiState, flecs::world& world)
         if (GuiButton({ guiState.windowBoxRect.x + 10, yOffset, 180, 30 }, "Remove All"))
         {
             TraceLog(LOG_INFO, "Removing all entities.");
-		    world.delete_with<Position>(); // Deletes all entities with Position
+		    ReleaseAllEntities(world); // parked for the next spawn, see EntityPool
+		    game_state.maxEntityRadius = game_state.entitySize;
+        }
+
+        yOffset += 30.f;
+        if (GuiButton({ guiState.windowBoxRect.x + 10, yOffset, 180, 30 }, "Trim Pool"))
+        {
+            TraceLog(LOG_INFO, "Deleting %d pooled entities.", PooledEntityCount(world));
+            TrimEntityPool(world);
         }
 
         yOffset += 30.f;
@@ -361,6 +261,17 @@ void DrawGUI(MyProjectGuiState& guiState, flecs::world& world)
             world.modified<GameState>();
         }
 
+        yOffset += 30.f;
+        bool mixedSizes = game_state.radiusModel == RadiusModel::PerEntity;
+        GuiCheckBox({ guiState.windowBoxRect.x + 10, yOffset, 25, 25 }, "Mixed sizes", &mixedSizes);
+        game_state.radiusModel = mixedSizes ? RadiusModel::PerEntity : RadiusModel::Uniform;
+
+        yOffset += 30.f;
+        GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Size variation:", TextFormat("%.2f", game_state.radiusVariation), &game_state.radiusVariation, 0.0f, 0.9f);
+
+        yOffset += 30.f;
+        GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Lifetime:", game_state.spawnLifetime > 0.0f ? TextFormat("%.1fs (%d)", game_state.spawnLifetime, static_cast<int>(sim.lifetimeWheel.PendingCount())) : "off", &game_state.spawnLifetime, 0.0f, 10.0f);
+
         yOffset += 30.f;
         GuiCheckBox({ guiState.windowBoxRect.x + 10, yOffset, 40, 25 }, "Render entities:", &game_state.renderEntities);
 	}
@@ -372,16 +283,224 @@ void DrawGUI(MyProjectGuiState& guiState, flecs::world& world)
 		yOffset += 30.f;
 		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Flecs logs level:", TextFormat("%.0f", game_state.entitySize), &game_state.entitySize, 0.01f, 100.0f);
 
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, "Collision effects:");
+
+		yOffset += 30.f;
+		int effect = static_cast<int>(game_state.collisionEffect);
+		GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 58, 25 }, "None;Entities;Particles", &effect);
+		game_state.collisionEffect = static_cast<CollisionEffect>(effect);
+
+		yOffset += 30.f;
+		GuiSpinner({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Per contact:", &game_state.sparksPerContact, 1, 64, false);
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Spark entities: %d", sim.sceneCounts.sparks));
+
+		yOffset += 30.f;
+		GuiCheckBox({ guiState.windowBoxRect.x + 10, yOffset, 25, 25 }, "Particle trails", &game_state.particleTrails);
+
+		yOffset += 30.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Drag:", TextFormat("%.1f", game_state.particleDrag), &game_state.particleDrag, 0.0f, 10.0f);
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Particles: %d / %d", sim.particles.Count(), sim.particles.Capacity()));
+
+	}
+	else if (guiState.activeTab == 2)
+	{
+		GameState& game_state = world.ensure<GameState>();
+
+		yOffset += 60.f;
+		int mode = static_cast<int>(game_state.simulationMode);
+		GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 88, 25 }, "Bounce;Fluid", &mode);
+		if (mode != static_cast<int>(game_state.simulationMode))
+		{
+			game_state.simulationMode = static_cast<SimulationMode>(mode);
+			ApplySimulationMode(world);
+		}
+
+		yOffset += 30.f;
+		int solver = static_cast<int>(game_state.collisionSolver);
+		GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 88, 25 }, "One-shot;Impulse", &solver);
+		if (solver != static_cast<int>(game_state.collisionSolver))
+		{
+			game_state.collisionSolver = static_cast<CollisionSolver>(solver);
+			ApplySimulationMode(world);
+		}
+
+		yOffset += 30.f;
+		int dimensionIndex = game_state.dimensions == 3 ? 1 : 0;
+		GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 43, 25 }, "2D;3D", &dimensionIndex);
+		game_state.dimensions = dimensionIndex == 1 ? 3 : 2;
+
+		yOffset += 30.f;
+		int precision = static_cast<int>(game_state.precision);
+		GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 58, 25 }, "Float;Double;FxContact", &precision);
+		game_state.precision = static_cast<Precision>(precision);
+
+		yOffset += 30.f;
+		int broadphase = static_cast<int>(game_state.broadphase);
+		GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 88, 25 }, "Hash;Grid", &broadphase);
+		game_state.broadphase = static_cast<BroadphaseKind>(broadphase);
+		yOffset += 30.f;
+		GuiCheckBox({ guiState.windowBoxRect.x + 10, yOffset, 25, 25 }, "Deterministic", &game_state.deterministic);
+		yOffset += 30.f;
+		GuiSpinner({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Iterations:", &game_state.solverVelocityIterations, 1, 64, false);
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Contacts: %d  Colors: %d", sim.collisionStats.contactCount, sim.collisionStats.colorCount));
+
+		yOffset += 30.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Gravity:", TextFormat("%.0f", game_state.gravity), &game_state.gravity, 0.0f, 5000.0f);
+
+		yOffset += 30.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Smoothing:", TextFormat("%.0f", game_state.fluidSmoothingRadius), &game_state.fluidSmoothingRadius, 2.0f, 100.0f);
+
+		yOffset += 30.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Rest density:", TextFormat("%.3f", game_state.fluidRestDensity), &game_state.fluidRestDensity, 0.0f, 0.1f);
+
+		yOffset += 30.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Stiffness:", TextFormat("%.0f", game_state.fluidStiffness), &game_state.fluidStiffness, 0.0f, 1000000.0f);
+
+		yOffset += 30.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Viscosity:", TextFormat("%.0f", game_state.fluidViscosity), &game_state.fluidViscosity, 0.0f, 2000.0f);
+	}
+	else if (guiState.activeTab == 3)
+	{
+		GameState& game_state = world.ensure<GameState>();
+
+		yOffset += 30.f;
+		GuiCheckBox({ guiState.windowBoxRect.x + 10, yOffset, 25, 25 }, "Simulation LOD", &game_state.simulationLod);
+
+		yOffset += 30.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Near radius:", TextFormat("%.0f", game_state.lodNearRadius), &game_state.lodNearRadius, 10.0f, 5000.0f);
+
+		yOffset += 30.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Far radius:", TextFormat("%.0f", game_state.lodFarRadius), &game_state.lodFarRadius, game_state.lodNearRadius, 10000.0f);
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Every %d frames: %d", SIM_LOD_MID_RATE, sim.sceneCounts.lodMid));
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Every %d frames: %d", SIM_LOD_FAR_RATE, sim.sceneCounts.lodFar));
+
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Periodic jobs: %d  fired: %d", sim.periodicJobs.JobCount(), sim.periodicJobs.FiredLastFrame()));
+
+		// deterministic worst cases for the broadphase, replace the current scene
+		yOffset += 40.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, "Stress scenes:");
+
+		yOffset += 30.f;
+		GuiToggleGroup({ guiState.windowBoxRect.x + 10, yOffset, 58, 25 }, "Cell;Lattice;Blob", &guiState.stressPattern);
+
+		yOffset += 30.f;
+		GuiSpinner({ guiState.windowBoxRect.x + 80, yOffset, 90, 25 }, "Count:", &guiState.stressCount, 1, 100000, false);
+
+		yOffset += 30.f;
+		if (GuiButton({ guiState.windowBoxRect.x + 10, yOffset, 180, 30 }, "Spawn"))
+		{
+			SpawnScenario(world, MakeStressScenario(static_cast<StressPattern>(guiState.stressPattern), guiState.stressCount, game_state.entitySize));
+		}
+	}
+	else if (guiState.activeTab == 4)
+	{
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Bodies: %d  Contacts: %d", sim.stats.bodies, sim.stats.contacts));
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Kinetic energy: %.3g", sim.stats.kineticEnergy));
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Momentum: %.0f %.0f %.0f", sim.stats.momentum.x, sim.stats.momentum.y, sim.stats.momentum.z));
+
+		yOffset += 30.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Max speed: %.1f", sim.stats.maxSpeed));
+
+		yOffset += 30.f;
+		const float meanPerCell = sim.stats.occupancy.occupiedCells > 0 ? static_cast<float>(sim.stats.occupancy.bodies) / sim.stats.occupancy.occupiedCells : 0.0f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 25 }, TextFormat("Cells: %d  max %d  mean %.1f", sim.stats.occupancy.occupiedCells, sim.stats.occupancy.maxPerCell, meanPerCell));
+
+		// one bar per bin, scaled to the fullest bin
+		int fullestBin = 1;
+		for (int bin = 0; bin < OCCUPANCY_BINS; ++bin)
+		{
+			fullestBin = std::max(fullestBin, sim.stats.occupancy.bins[bin]);
+		}
+		for (int bin = 0; bin < OCCUPANCY_BINS; ++bin)
+		{
+			yOffset += 20.f;
+			const float fill = static_cast<float>(sim.stats.occupancy.bins[bin]) / fullestBin;
+			GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 50, 18 }, TextFormat("%d+", 1 << bin));
+			DrawRectangleRec({ guiState.windowBoxRect.x + 60, yOffset + 3, 120 * fill, 12 }, SKYBLUE);
+		}
+	}
+	else if (guiState.activeTab == 5)
+	{
+		yOffset += 30.f;
+		bool counters = g_systemProfiler.CountersEnabled();
+		GuiCheckBox({ guiState.windowBoxRect.x + 10, yOffset, 25, 25 }, "HW counters", &counters);
+		if (counters != g_systemProfiler.CountersEnabled())
+		{
+			g_systemProfiler.SetCountersEnabled(counters);
+			g_systemProfiler.Reset();
+		}
+		if (GuiButton({ guiState.windowBoxRect.x + 120, yOffset, 60, 25 }, "Reset"))
+		{
+			g_systemProfiler.Reset();
+			g_frameTimes.Reset();
+		}
+
+		if (!g_systemProfiler.CountersAvailable())
+		{
+			yOffset += 25.f;
+			GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 20 }, g_systemProfiler.CountersUnavailableReason().c_str());
+		}
+
+		yOffset += 25.f;
+		GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 20 }, TextFormat("p50 %.1f p99 %.1f p99.9 %.1f ms", g_frameTimes.Percentile(0.5), g_frameTimes.Percentile(0.99), g_frameTimes.Percentile(0.999)));
+
+		yOffset += 25.f;
+		GuiSlider({ guiState.windowBoxRect.x + 80, yOffset, 90, 20 }, "Hitch ms:", TextFormat("%.0f", g_hitchDetector.thresholdMs), &g_hitchDetector.thresholdMs, 0.0f, 200.0f);
+
+		yOffset += 25.f;
+		GuiCheckBox({ guiState.windowBoxRect.x + 10, yOffset, 20, 20 }, "World", &g_hitchDetector.captureWorld);
+		GuiLabel({ guiState.windowBoxRect.x + 80, yOffset, 100, 20 }, TextFormat("Hitches: %d", g_hitchDetector.captures));
+
+		// the most expensive systems, per frame since the last reset
+		std::vector<SystemProfiler::SystemStats> systems = g_systemProfiler.Snapshot();
+		std::sort(systems.begin(), systems.end(), [](const auto& a, const auto& b) { return a.cpuMs > b.cpuMs; });
+		const double frames = static_cast<double>(std::max<uint64_t>(g_systemProfiler.Frames(), 1));
+		const bool showCounters = g_systemProfiler.CountersEnabled();
+		for (size_t i = 0; i < std::min<size_t>(systems.size(), 6) && systems[i].runs > 0; ++i)
+		{
+			const SystemProfiler::SystemStats& system = systems[i];
+			yOffset += 25.f;
+			GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 20 }, TextFormat("%s %.3f ms", system.name.c_str(), system.cpuMs / frames));
+			if (showCounters && system.counters[PERF_INSTRUCTIONS] > 0)
+			{
+				const double kiloInstructions = system.counters[PERF_INSTRUCTIONS] / 1000.0;
+				yOffset += 16.f;
+				GuiLabel({ guiState.windowBoxRect.x + 10, yOffset, 180, 16 }, TextFormat("IPC %.2f L1 %.1f LLC %.2f Br %.1f /ki",
+					static_cast<double>(system.counters[PERF_INSTRUCTIONS]) / std::max<uint64_t>(system.counters[PERF_CYCLES], 1),
+					system.counters[PERF_L1D_MISSES] / kiloInstructions,
+					system.counters[PERF_LLC_MISSES] / kiloInstructions,
+					system.counters[PERF_BRANCH_MISSES] / kiloInstructions));
+			}
+		}
 	}
 }
 
 void DrawLogPanel()
 {
+    INSTRUMENT_ZONE("DrawLogPanel");
     static Vector2 scrollPos = { 0, 0 };
     static Rectangle panelRec = { 0, SCREEN_HEIGHT - 120, (float)SCREEN_WIDTH, 120 };
     Rectangle panelContentRec;
     {
-        std::lock_guard<std::mutex> lock(logMutex);
+        std::lock_guard<InstrumentedMutex> lock(logMutex);
         panelContentRec = { 0, 0, panelRec.width - 20, (float)logMessages.size() * 20 };
     }
     static Rectangle panelView = { 0 };
@@ -393,7 +512,7 @@ void DrawLogPanel()
     Rectangle clearButtonRec = { panelRec.x + panelRec.width - 80, panelRec.y + 2, 70, 20 };
     if (GuiButton(clearButtonRec, "Clear"))
     {
-        std::lock_guard<std::mutex> lock(logMutex);
+        std::lock_guard<InstrumentedMutex> lock(logMutex);
         logMessages.clear();
         // Optionally, add a log message to confirm clearing
         // This would require re-locking or a more complex log call
@@ -401,7 +520,7 @@ void DrawLogPanel()
 
     BeginScissorMode((int)panelView.x, (int)panelView.y, (int)panelView.width, (int)panelView.height);
     {
-        std::lock_guard<std::mutex> lock(logMutex);
+        std::lock_guard<InstrumentedMutex> lock(logMutex);
         for (size_t i = 0; i < logMessages.size(); ++i)
         {
             Rectangle itemRec = 
@@ -426,221 +545,6 @@ void DrawLogPanel()
 
 
 
-void DeclareGameStateObserver(flecs::world& world)
-{
-    world.observer<GameState>()
-        //.kind<StateObserverSystem>()
-        .event(flecs::OnSet)
-        .each([&](flecs::entity e, GameState& gs)
-        {
-            // update velocity
-
-            //std::cout << "Position set: {" << p.x << ", " << p.y << "}\n";
-				world.query<Velocity>().each([&](flecs::entity e, Velocity& v)
-				{
-                    v = { Vector3Scale(Vector3Normalize(v.value), gs.entitySpeed) };
-				});
-        });
-}
-
-struct BounceSystem
-{
-};
-void DeclareDetectGridEntityCollision(flecs::world& world, const flecs::entity& inPhase)
-{
-    world.system<Position, Velocity, ColorComp, CollisionResponse>("DetectGridEntity")
-        .kind(inPhase)
-        .read<Position>()
-        .read<Velocity>()
-        .write<CollisionResponse>()
-        .each([&](Position& p, Velocity& v, ColorComp& /*c*/, CollisionResponse& resp)
-        {
-            const GameState& game_state = world.get<GameState>();
-            bool bounced = false;
-            Vector3 normal{ 0, 0, 0 };
-            Vector3 posFix{ 0, 0, 0 };
-
-            // Left
-            if (p.value.x - game_state.entitySize < -game_state.gridSize && v.value.x < 0)
-            {
-                float overlap = (-game_state.gridSize + game_state.entitySize) - p.value.x;
-                posFix.x += overlap;
-                normal = Vector3Add(normal, Vector3{ 1, 0, 0 });
-                bounced = true;
-            }
-            // Right
-            if (p.value.x + game_state.entitySize > game_state.gridSize && v.value.x > 0)
-            {
-                float overlap = (game_state.gridSize - game_state.entitySize) - p.value.x;
-                posFix.x += overlap;
-                normal = Vector3Add(normal, Vector3{ -1, 0, 0 });
-                bounced = true;
-            }
-            // Bottom
-            if (p.value.y - game_state.entitySize < -game_state.gridSize && v.value.y < 0)
-            {
-                float overlap = (-game_state.gridSize + game_state.entitySize) - p.value.y;
-                posFix.y += overlap;
-                normal = Vector3Add(normal, Vector3{ 0, 1, 0 });
-                bounced = true;
-            }
-            // Top
-            if (p.value.y + game_state.entitySize > game_state.gridSize && v.value.y > 0)
-            {
-                float overlap = (game_state.gridSize - game_state.entitySize) - p.value.y;
-                posFix.y += overlap;
-                normal = Vector3Add(normal, Vector3{ 0, -1, 0 });
-                bounced = true;
-            }
-
-            if (bounced)
-            {
-                // Normalize the combined normal if any component present
-                if (Vector3Length(normal) > 0.0f) normal = Vector3Normalize(normal);
-                // Compute reflected velocity; store as delta
-                Vector3 reflected = Vector3Reflect(v.value, normal);
-                resp.posDelta = Vector3Add(resp.posDelta, posFix);
-                resp.velDelta = Vector3Add(resp.velDelta, Vector3Subtract(reflected, v.value));
-                resp.hasCollision = true;
-            }
-        });
-}
-
-void DeclareMoveEntitiesSystem(flecs::world& world, const flecs::entity& inPhase)
-{
-    // System to update position based on velocity
-    world.system<Position, const Velocity>("MoveEntities")
-		.multi_threaded()
-        .kind(inPhase)
-		.read<Velocity>()
-		.write<Position>()
-        .each([&](flecs::entity e, Position& p, const Velocity& v)
-         {
-            const float clampedDeltaTime = std::min(world.delta_time(), 0.33f);
-            p.value = Vector3Add(p.value, Vector3Scale(v.value, clampedDeltaTime));
-         });
-}
-
-// Clear spatial buckets once per frame before filling them
-void DeclareClearSpatialBucketsSystem(flecs::world& world, const flecs::entity& inPhase)
-{
-    world.system<>("ClearSpatialBuckets")
-        .kind(inPhase)
-        .each([&]()
-        {
-            g_cellBuckets.clear();
-        });
-}
-
-// Update spatial cell for each entity and fill buckets
-void DeclareUpdateSpatialCellSystem(flecs::world& world, const flecs::entity& inPhase)
-{
-    world.system<const Position, SpatialCell>("UpdateSpatialCell")
-        //.multi_threaded()
-        .kind(inPhase)
-        .read<Position>()
-        .write<SpatialCell>()
-        .each([&](flecs::entity e, const Position& p, SpatialCell& sc)
-        {
-            const GameState& game_state = world.get<GameState>();
-            const float cellSize = std::max(game_state.entitySize * 2.0f, 1.0f);
-            auto [cx, cy] = ComputeCell(p.value, cellSize);
-            sc.cellX = cx;
-            sc.cellY = cy;
-            const int32_t cellIndex = CellKey(cx, cy);
-           // assert(cellIndex)
-            g_cellBuckets[cellIndex].push_back(e); // can cause thread collision
-        });
-}
-
- void DeclareDetectEntitiesCollision(flecs::world& world, const flecs::entity& inPhase)
-{
-    // Broadphase collision: record responses instead of directly mutating P/V
-    world.system<const Position, const Velocity, const SpatialCell, CollisionResponse>("DetectEntitiesCollision")
-        .kind(inPhase) // keep single-threaded to avoid cross-entity write races
-        .read<Position>()
-        .read<Velocity>()
-        .read<SpatialCell>()
-        .write<CollisionResponse>()
-        .each([&](flecs::entity e1, const Position& p1, const Velocity& v1, const SpatialCell& sc1, CollisionResponse& r1)
-        {
-            const GameState& game_state = world.get<GameState>();
-            const float requiredDistance = game_state.entitySize * 2.0f;
-
-            for (int dy = -1; dy <= 1; ++dy)
-            {
-                for (int dx = -1; dx <= 1; ++dx)
-                {
-                    const int nx = sc1.cellX + dx;
-                    const int ny = sc1.cellY + dy;
-                    auto it = g_cellBuckets.find(CellKey(nx, ny));
-                    if (it == g_cellBuckets.end()) continue;
-
-                    const auto& bucket = it->second;
-                    for (const flecs::entity& e2 : bucket)
-                    {
-                        if (e1.id() >= e2.id()) continue; // process pair once
-
-                        auto p2 = e2.get<Position>();
-                        auto v2 = e2.get<Velocity>();
-                        //if (!p2 || !v2) continue;
-
-                        const float distance = Vector3Distance(p1.value, p2.value);
-                        if (distance < requiredDistance)
-                        {
-                            const float overlap = requiredDistance - distance;
-                            const Vector3 direction = (distance > 0.0f)
-                                ? Vector3Normalize(Vector3Subtract(p1.value, p2.value))
-                                : Vector3{ 1, 0, 0 };
-
-                            const Vector3 p1_move = Vector3Scale(direction, overlap * 0.5f);
-                            const Vector3 p2_move = Vector3Scale(direction, -overlap * 0.5f);
-
-                            // Record response for e1
-                            const Vector3 v1_reflect = Vector3Reflect(v1.value, direction);
-                            r1.posDelta = Vector3Add(r1.posDelta, p1_move);
-                            r1.velDelta = Vector3Add(r1.velDelta, Vector3Subtract(v1_reflect, v1.value));
-                            r1.hasCollision = true;
-
-                            // Record response for e2
-                            auto r2 = e2.get_mut<CollisionResponse>();
-                            r2.posDelta = Vector3Add(r2.posDelta, p2_move);
-                            const Vector3 v2_reflect = Vector3Reflect(v2.value, Vector3Negate(direction));
-                            r2.velDelta = Vector3Add(r2.velDelta, Vector3Subtract(v2_reflect, v2.value));
-                            r2.hasCollision = true;
-                        }
-                    }
-                }
-            }
-        });
- }
-
-// Apply accumulated responses and reset
-void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entity& inPhase)
-{
-    world.system<Position, Velocity, ColorComp, CollisionResponse>("ApplyCollisionResponse")
-        .kind(inPhase)
-        .write<Position>()
-        .write<Velocity>()
-        .write<ColorComp>()
-        .write<CollisionResponse>()
-        .each([&](Position& p, Velocity& v, ColorComp &c, CollisionResponse& resp)
-        {
-            if (!resp.hasCollision)
-                return;
-
-            p.value = Vector3Add(p.value, resp.posDelta);
-            v.value = Vector3Add(v.value, resp.velDelta);
-            c.value = GetRandomColor();
-
-            // reset accumulator
-            resp.posDelta = Vector3Zero();
-            resp.velDelta = Vector3Zero();
-            resp.hasCollision = false;
-        });
- }
-
-
  void CreateInitialEntities(flecs::world ecs)
  {
      // --- Entity Creation with overlap prevention ---
@@ -652,28 +556,35 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
 
  void RenderEntities(GameData& gameData)
  {
+    INSTRUMENT_ZONE("RenderEntities");
 	const GameState& game_state = gameData.world->get<GameState>();
 	if (!game_state.renderEntities)
 	{
 		return;
 	}
 
-    auto q = gameData.world->query<Position>();
-	int count = q.count();
+    const Render& render = gameData.world->get<Render>();
+	int count = render.bodies.count();
 
+    // sized from the loop, parked entities are skipped by the query but may be in the count
     gameData.renderingData.transforms.resize(count);
 
     int index = 0;
-    gameData.world->each([&](flecs::entity e, const Position& p, const ColorComp& c)
+    const bool perEntityRadius = game_state.radiusModel == RadiusModel::PerEntity;
+    render.bodies.each([&](flecs::entity e, const Position& p, const ColorComp& c, const Radius& r)
     {
 
+        if (index >= static_cast<int>(gameData.renderingData.transforms.size()))
+            gameData.renderingData.transforms.emplace_back();
         Matrix& EntityTransform = gameData.renderingData.transforms[index];
         //EntityTransform = ;
-        EntityTransform = MatrixScale(game_state.entitySize, game_state.entitySize, game_state.entitySize) * MatrixTranslate(p.value.x, p.value.y, p.value.z);
+        const float scale = perEntityRadius ? r.value : game_state.entitySize;
+        EntityTransform = MatrixScale(scale, scale, scale) * MatrixTranslate(p.value.x, p.value.y, p.value.z);
         index++;
 
         //DrawSphere(p.value, game_state.entitySize, c.value);
     });
+    gameData.renderingData.transforms.resize(index);
 
 
 	// Draw meshes instanced using material containing instancing shader (RED + lighting),
@@ -694,11 +605,47 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
          gameData.renderingData.material,
          gameData.renderingData.transforms.data(),
          gameData.renderingData.transforms.size());
+
+    // spark entities as additive billboards
+    BeginBlendMode(BLEND_ADDITIVE);
+    render.sparks.each([&](const Position& p, const ColorComp& c, const Radius& r)
+        {
+            DrawBillboard(gameData.camera, gameData.renderingData.sparkTexture, p.value, r.value * 4.0f, c.value);
+        });
+    EndBlendMode();
+ }
+
+ // All live particles in one additive instanced draw, see particle_renderer.h
+ void RenderParticles(GameData& gameData)
+ {
+    INSTRUMENT_ZONE("RenderParticles");
+    const ParticleSystem& particles = GetSimulationState(*gameData.world).particles;
+    if (particles.Count() == 0)
+        return;
+
+    BeginBlendMode(BLEND_ADDITIVE);
+    DrawParticlesInstanced(gameData.renderingData.particles, particles, gameData.renderingData.sparkTexture, gameData.camera);
+    EndBlendMode();
+ }
+
+ // One line per phase in start order; background phases overlap the main thread's
+ void LogStartupReport()
+ {
+    std::vector<StartupTimeline::Phase> phases = g_startupTimeline.Phases();
+    std::sort(phases.begin(), phases.end(), [](const StartupTimeline::Phase& a, const StartupTimeline::Phase& b) { return a.startMs < b.startMs; });
+
+    TraceLog(LOG_INFO, "Startup: first frame after %.1f ms", g_startupTimeline.FirstFrameMs());
+    for (const StartupTimeline::Phase& phase : phases)
+    {
+        TraceLog(LOG_INFO, "  %-20s %7.1f ms  [%.1f, %.1f]%s", phase.name.c_str(), phase.endMs - phase.startMs, phase.startMs, phase.endMs,
+            phase.background ? " background" : "");
+    }
  }
 
  void DoMainGameLoop(GameData& gameData)
  {
      // --- Main Game Loop ---
+     auto frameStart = std::chrono::steady_clock::now();
      while (!WindowShouldClose())
      {
          // --- Update ---
@@ -712,9 +659,20 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
              UpdateCamera(&gameData.camera, CAMERA_FREE /*CAMERA_ORBITAL*/); // Enable orbital camera controls
          }
 
+         // full-rate simulation follows what the camera looks at
+         gameData.world->ensure<GameState>().lodFocus = gameData.camera.target;
+
+
+#ifdef PHYSICS_HOT_RELOAD
+         // picks up a rebuilt MyProjectPhysics between frames, the scene stays as it is
+         PollPhysicsModule(*gameData.world);
+#endif
 
          const float frameTime = GetFrameTime();
-         gameData.world->progress(frameTime); // This runs all the systems
+         {
+             INSTRUMENT_ZONE("progress");
+             gameData.world->progress(frameTime); // This runs all the systems
+         }
 
          // --- Draw ---
          BeginDrawing();
@@ -730,6 +688,7 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
 
          // Render entities
          RenderEntities(gameData);
+         RenderParticles(gameData);
 
 
          EndMode3D();
@@ -744,7 +703,29 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
          DrawText("flecs + raylib | Use mouse to control camera (orbit, zoom, pan)", 10, 10, 20, GREEN);
          DrawFPS(10, 40);
 
-         EndDrawing();
+         {
+             INSTRUMENT_ZONE("EndDrawing"); // includes the buffer swap, and the vsync wait with it
+             EndDrawing();
+         }
+         INSTRUMENT_FRAME_MARK;
+
+         if (g_startupTimeline.FirstFrameMs() < 0.0)
+         {
+             // raygui loads its default style on the first Gui call, which this frame includes
+             g_startupTimeline.Record("FirstFrame", frameStart, std::chrono::steady_clock::now());
+             g_startupTimeline.MarkFirstFrame();
+             LogStartupReport();
+         }
+
+         // the whole iteration, vsync wait included: that is what a stutter looks like on screen
+         const auto frameEnd = std::chrono::steady_clock::now();
+         size_t logMessageCount;
+         {
+             std::lock_guard<InstrumentedMutex> lock(logMutex);
+             logMessageCount = logMessagesTotal;
+         }
+         RecordFrame(*gameData.world, std::chrono::duration<double, std::milli>(frameEnd - frameStart).count(), logMessageCount);
+         frameStart = frameEnd;
      }
  }
 
@@ -759,46 +740,18 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
  }
 
 
-// /** OS API log function type. */
-// typedef
-// void (*ecs_os_api_log_t)(
-// 	int32_t level,     /* Logging level */
-// 	const char* file,  /* File where message was logged */
-// 	int32_t line,      /* Line it was logged */
-// 	const char* msg);
-
- void OnFlecsLogCallback(int level, const char* file, int32_t line, const char* msg)
- {
-	// Example: print only warnings and errors
-	if (level >= 1)
-	{
-		fprintf(stderr, "Flecs Log [Level %d]: %s\n", level, msg);
-
-		TraceLog(level, msg);
-	}
-
-
- }
-
-
- void InitFlecs(GameData& gameData)
- {
-	gameData.world = new flecs::world();
-
-	ecs_os_api.log_ = OnFlecsLogCallback;
-
-	flecs::log::set_level(3);
-
-
-    gameData.world->set_threads(4);
- }
+ // Instanced body mesh: quantized normals and texcoords, 24 bytes a vertex instead of 32 (mesh_cache.h)
+ static const MeshKey BODY_MESH = SphereMeshKey(1.f, 32, 32, MeshVertexFormat::Quantized16);
 
-
- void InitRenderingData(RenderingData& renderingData)
+ // File reads, image decoding and the mesh cache: nothing here touches the GL context
+ RenderAssets PrepareRenderAssets()
  {
+    StartupPhase phase(g_startupTimeline, "PrepareRenderAssets", true);
+    RenderAssets assets;
 
-    std::string lighting_instancing_vs = TextFormat("res/shaders/glsl%i/lighting_instancing.vs", GLSL_VERSION);
-    std::string lighting_fs = TextFormat("res/shaders/glsl%i/lighting.fs", GLSL_VERSION);
+    // std::format, TextFormat's buffers are shared with the main thread
+    const std::string lighting_instancing_vs = std::format("res/shaders/glsl{}/lighting_instancing.vs", GLSL_VERSION);
+    const std::string lighting_fs = std::format("res/shaders/glsl{}/lighting.fs", GLSL_VERSION);
 
     if (!FileExists(lighting_instancing_vs.data()))
     {
@@ -810,8 +763,24 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
 		TraceLog(LOG_ERROR, "lighting_fs is invalid");
 	}
 
+    assets.instancingVs = LoadFileText(lighting_instancing_vs.data());
+    assets.lightingFs = LoadFileText(lighting_fs.data());
+    assets.particleVs = LoadFileText(std::format("res/shaders/glsl{}/particle_instancing.vs", GLSL_VERSION).c_str());
+    assets.particleFs = LoadFileText(std::format("res/shaders/glsl{}/particle_instancing.fs", GLSL_VERSION).c_str());
+    {
+        StartupPhase meshPhase(g_startupTimeline, "PrepareBodyMesh", true);
+        assets.sphere = PrepareCachedMesh(BODY_MESH);
+    }
+    assets.spark = LoadImage("res/spark_flame.png");
+    return assets;
+ }
+
+ void InitRenderingData(RenderingData& renderingData, RenderAssets& assets)
+ {
 	// Load lighting shader
-	Shader shader = LoadShader(lighting_instancing_vs.data(), lighting_fs.data());
+	Shader shader = LoadShaderFromMemory(assets.instancingVs, assets.lightingFs);
+    UnloadFileText(assets.instancingVs);
+    UnloadFileText(assets.lightingFs);
 	// Get shader locations
 	shader.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(shader, "mvp");
 	shader.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(shader, "viewPos");
@@ -831,70 +800,104 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
 	matInstances.shader = shader;
 	matInstances.maps[MATERIAL_MAP_DIFFUSE].color = RED;
 
-    renderingData.cube = GenMeshSphere(1.f, 32, 32);
+    renderingData.cube = UploadCachedMesh(assets.sphere);
     renderingData.material = matInstances;
     renderingData.shader = shader;
 
     // Get uniforms for per-instance coloring
     renderingData.locInstanceCount = GetShaderLocation(renderingData.shader, "uInstanceCount");
     renderingData.locInstanceColors = GetShaderLocation(renderingData.shader, "uInstanceColors");
- }
-
-
- void DeclareECS(GameData& gameData)
- {
-     flecs::world* world = gameData.world;
-
-    // declare the phases
-    flecs::entity PrePhysics = world->entity("PrePhysics").add(flecs::Phase);
-    flecs::entity Physics = world->entity("Physics").add(flecs::Phase).depends_on(PrePhysics);
-    flecs::entity PostPhysics = world->entity("PostPhysics").add(flecs::Phase).depends_on(Physics);
-
-    DeclareGameStateObserver(*gameData.world);
-
-    // Pre-physics: build spatial grid and resolve collision responses
-    DeclareClearSpatialBucketsSystem(*gameData.world, PrePhysics);
-    DeclareUpdateSpatialCellSystem(*gameData.world, PrePhysics);
 
-    DeclareDetectEntitiesCollision(*gameData.world, PrePhysics);
-    DeclareDetectGridEntityCollision(*gameData.world, PrePhysics);
+    renderingData.sparkTexture = LoadTextureFromImage(assets.spark);
+    UnloadImage(assets.spark);
 
-    DeclareApplyCollisionResponseSystem(*gameData.world, PrePhysics);
-
-    // Integrate after applying collision responses
-    DeclareMoveEntitiesSystem(*gameData.world, PrePhysics);
-
-    // singletons
-    gameData.world->set<GameState>({});
+    renderingData.particles = LoadParticleRenderer(assets.particleVs, assets.particleFs);
+    UnloadFileText(assets.particleVs);
+    UnloadFileText(assets.particleFs);
  }
 
-
- int main(void)
+ int main(int argc, char** argv)
  {
+    const LaunchOptions options = ParseLaunchOptions(argc, argv);
+    if (options.headless)
+    {
+        return RunHeadlessBenchmark(options);
+    }
+
 
     GameData gameData;
 
     // --- Initialization ---
-    SetConfigFlags(FLAG_MSAA_4X_HINT);
-    InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "flecs + raylib - ECS Collision Demo");
-    SetTargetFPS(60);
+    {
+        StartupPhase phase(g_startupTimeline, "InitWindow");
+        SetConfigFlags(FLAG_MSAA_4X_HINT);
+        InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "flecs + raylib - ECS Collision Demo");
+        SetTargetFPS(60);
+    }
 
-	// Set custom logger
+	// Set custom logger, for raylib and the simulation library alike
 	SetTraceLogCallback(CustomLog);
+	SetSimLogCallback(CustomLog);
 
     TraceLog(LOG_INFO, "Application started.");
 
-    // --- Flecs World Setup ---
-    InitFlecs(gameData);
-
-    InitRenderingData(gameData.renderingData);
+    // Shader sources, the sphere mesh and the spark image load on a worker while the world is
+    // set up; only the GPU uploads after the join need the GL thread
+    std::future<RenderAssets> renderAssets = std::async(std::launch::async, PrepareRenderAssets);
 
+    // --- Flecs World Setup ---
+    {
+        StartupPhase phase(g_startupTimeline, "CreateWorld");
+        gameData.world = CreateSimulationWorld();
+    }
 
     // --- Systems Definition ---
-    DeclareECS(gameData);
+    {
+        StartupPhase phase(g_startupTimeline, "DeclareECS");
+        DeclareECS(*gameData.world);
+        InstallDiagnostics(*gameData.world);
+    }
+
+    if (options.metricsPort > 0)
+    {
+        StartMetrics(*gameData.world, options.metricsPort);
+    }
+    if (options.hitchMs >= 0.0f)
+    {
+        g_hitchDetector.thresholdMs = options.hitchMs;
+    }
 
+    {
+        StartupPhase phase(g_startupTimeline, "SpawnScene");
+        if (!options.scenarioPath.empty())
+        {
+            Scenario scenario;
+            std::string error;
+            if (LoadScenario(options.scenarioPath, scenario, error))
+            {
+                SpawnScenario(*gameData.world, scenario);
+            }
+            else
+            {
+                TraceLog(LOG_WARNING, "Scenario not loaded: %s", error.c_str());
+                CreateInitialEntities(*gameData.world);
+            }
+        }
+        else
+        {
+            CreateInitialEntities(*gameData.world);
+        }
+    }
 
-    CreateInitialEntities(*gameData.world);
+    {
+        RenderAssets assets;
+        {
+            StartupPhase phase(g_startupTimeline, "WaitRenderAssets"); // the worker's remainder, if any
+            assets = renderAssets.get();
+        }
+        StartupPhase phase(g_startupTimeline, "InitRenderingData");
+        InitRenderingData(gameData.renderingData, assets);
+    }
 
     // --- Raylib Camera Setup ---
     InitCamera3D(gameData.camera);
@@ -906,7 +909,8 @@ void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entit
 
 
     // --- De-Initialization ---
+    StopMetricsServer();
     CloseWindow();
 
     return 0;
- }
\ No newline at end of file
+ }
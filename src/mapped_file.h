@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// --- Read-only memory mapping of a whole file.
+// Pages are read in on first touch and stay in the OS page cache between runs, so opening a
+// file that was mapped recently costs no read at all. The OS calls live in mapped_file.cpp,
+// away from raylib's headers (windows.h declares CloseWindow, DrawText, ...).
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { *this = static_cast<MappedFile&&>(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // False when the file is missing, empty or cannot be mapped; the previous mapping is closed either way
+    bool Open(const std::string& path);
+    void Close();
+
+    const unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    void* mapping = nullptr; // the file mapping object; the file handle is closed once mapped
+#endif
+};
@@ -0,0 +1,283 @@
+#include "mesh_cache.h"
+#include "rlgl.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <system_error>
+
+#ifndef RL_SHORT
+#define RL_SHORT 0x1402          // GL_SHORT
+#endif
+#ifndef RL_UNSIGNED_SHORT
+#define RL_UNSIGNED_SHORT 0x1403 // GL_UNSIGNED_SHORT
+#endif
+#ifndef RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES
+#define RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES 6 // the index buffer's vboId slot before raylib 5.5 named it
+#endif
+
+// UnloadMesh frees every one of raylib's VBO slots (MAX_MESH_VERTEX_BUFFERS, 7 to 9 depending on
+// the version); the unused ones stay 0
+static const int MESH_VBO_SLOTS = 16;
+
+static const uint32_t MESH_BLOB_MAGIC = 0x4853454D; // "MESH" read as little-endian, a byte-swapped blob does not match
+static const uint32_t MESH_BLOB_VERSION = 2; // 2: MeshKey::generatorVersion
+static const uint64_t MESH_BLOB_ALIGNMENT = 16;
+
+// Native byte order. Offsets are from the start of the blob, so the arrays are aligned in a mapping.
+struct MeshBlobHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    MeshKey key;
+    uint32_t vertexCount;
+    uint32_t triangleCount; // the offsets below start 8-byte aligned, no padding
+    uint64_t positionsOffset;
+    uint64_t normalsOffset;
+    uint64_t texcoordsOffset;
+    uint64_t indicesOffset;
+    uint64_t size; // of the whole blob, so a truncated file is caught
+};
+
+static uint64_t AlignBlobOffset(uint64_t offset)
+{
+    return (offset + MESH_BLOB_ALIGNMENT - 1) / MESH_BLOB_ALIGNMENT * MESH_BLOB_ALIGNMENT;
+}
+
+static uint64_t NormalBytes(MeshVertexFormat format, uint64_t vertexCount)
+{
+    return vertexCount * (format == MeshVertexFormat::Quantized16 ? 4 * sizeof(int16_t) : 3 * sizeof(float));
+}
+
+static uint64_t TexcoordBytes(MeshVertexFormat format, uint64_t vertexCount)
+{
+    return vertexCount * (format == MeshVertexFormat::Quantized16 ? 2 * sizeof(uint16_t) : 2 * sizeof(float));
+}
+
+// Offsets and size for the counts and format already in the header
+static void LayOutBlob(MeshBlobHeader& header)
+{
+    const MeshVertexFormat format = header.key.format;
+    header.positionsOffset = AlignBlobOffset(sizeof(MeshBlobHeader));
+    header.normalsOffset = AlignBlobOffset(header.positionsOffset + uint64_t(header.vertexCount) * 3 * sizeof(float));
+    header.texcoordsOffset = AlignBlobOffset(header.normalsOffset + NormalBytes(format, header.vertexCount));
+    header.indicesOffset = AlignBlobOffset(header.texcoordsOffset + TexcoordBytes(format, header.vertexCount));
+    header.size = header.indicesOffset + uint64_t(header.triangleCount) * 3 * sizeof(unsigned short);
+}
+
+static const char* GeneratorName(MeshGenerator generator)
+{
+    switch (generator)
+    {
+    case MeshGenerator::Sphere: return "sphere";
+    }
+    return "unknown";
+}
+
+std::string MeshCachePath(const MeshKey& key)
+{
+    return std::format("{}/{}-v{}-{:g}-{:g}-{:g}-{}.mesh", MESH_CACHE_DIR, GeneratorName(key.generator), key.generatorVersion,
+        key.params[0], key.params[1], key.params[2], key.format == MeshVertexFormat::Quantized16 ? "q16" : "f32");
+}
+
+// Points the CachedMesh arrays into a blob; false if the blob is not a complete one for this key
+static_assert(sizeof(MeshBlobHeader) == 80, "MeshBlobHeader has padding, the blob would carry uninitialized bytes");
+
+static bool ViewBlob(const unsigned char* data, size_t size, const MeshKey& key, CachedMesh& mesh)
+{
+    MeshBlobHeader header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != MESH_BLOB_MAGIC || header.version != MESH_BLOB_VERSION
+        || std::memcmp(&header.key, &key, sizeof(MeshKey)) != 0
+        || header.vertexCount == 0 || header.vertexCount > 65536 || header.size != size) // 16-bit indices
+        return false;
+
+    // the offsets must be the ones this version writes, which also keeps every array inside the blob
+    MeshBlobHeader expected = header;
+    LayOutBlob(expected);
+    if (expected.positionsOffset != header.positionsOffset || expected.normalsOffset != header.normalsOffset
+        || expected.texcoordsOffset != header.texcoordsOffset || expected.indicesOffset != header.indicesOffset
+        || expected.size != header.size)
+        return false;
+
+    mesh.format = key.format;
+    mesh.vertexCount = static_cast<int>(header.vertexCount);
+    mesh.triangleCount = static_cast<int>(header.triangleCount);
+    mesh.positions = reinterpret_cast<const float*>(data + header.positionsOffset);
+    mesh.normals = data + header.normalsOffset;
+    mesh.texcoords = data + header.texcoordsOffset;
+    mesh.indices = reinterpret_cast<const unsigned short*>(data + header.indicesOffset);
+    return true;
+}
+
+static Mesh GenerateMeshData(const MeshKey& key)
+{
+    switch (key.generator)
+    {
+    case MeshGenerator::Sphere:
+        return GenSphereMeshData(key.params[0], static_cast<int>(key.params[1]), static_cast<int>(key.params[2]));
+    }
+    return Mesh{ 0 };
+}
+
+// The arrays only: the mesh was never uploaded, and UnloadMesh would call into GL
+static void FreeMeshData(Mesh& mesh)
+{
+    MemFree(mesh.vertices);
+    MemFree(mesh.normals);
+    MemFree(mesh.texcoords);
+    MemFree(mesh.indices);
+    mesh = Mesh{ 0 };
+}
+
+static std::vector<unsigned char> BuildBlob(const MeshKey& key, const Mesh& mesh)
+{
+    MeshBlobHeader header = {};
+    header.magic = MESH_BLOB_MAGIC;
+    header.version = MESH_BLOB_VERSION;
+    header.key = key;
+    header.vertexCount = static_cast<uint32_t>(mesh.vertexCount);
+    header.triangleCount = static_cast<uint32_t>(mesh.triangleCount);
+    LayOutBlob(header);
+
+    std::vector<unsigned char> blob(header.size, 0);
+    unsigned char* data = blob.data();
+    std::memcpy(data, &header, sizeof(header));
+    std::memcpy(data + header.positionsOffset, mesh.vertices, mesh.vertexCount * 3 * sizeof(float));
+    std::memcpy(data + header.indicesOffset, mesh.indices, mesh.triangleCount * 3 * sizeof(unsigned short));
+
+    if (key.format == MeshVertexFormat::Quantized16)
+    {
+        int16_t* normals = reinterpret_cast<int16_t*>(data + header.normalsOffset);
+        uint16_t* texcoords = reinterpret_cast<uint16_t*>(data + header.texcoordsOffset);
+        for (int v = 0; v < mesh.vertexCount; ++v)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                normals[v * 4 + k] = static_cast<int16_t>(std::lround(std::clamp(mesh.normals[v * 3 + k], -1.0f, 1.0f) * 32767.0f));
+            }
+            for (int k = 0; k < 2; ++k)
+            {
+                texcoords[v * 2 + k] = static_cast<uint16_t>(std::lround(std::clamp(mesh.texcoords[v * 2 + k], 0.0f, 1.0f) * 65535.0f));
+            }
+        }
+    }
+    else
+    {
+        std::memcpy(data + header.normalsOffset, mesh.normals, mesh.vertexCount * 3 * sizeof(float));
+        std::memcpy(data + header.texcoordsOffset, mesh.texcoords, mesh.vertexCount * 2 * sizeof(float));
+    }
+    return blob;
+}
+
+// Written next to the final name and renamed over it, so no run ever maps a half-written blob
+static bool WriteBlob(const std::string& path, const std::vector<unsigned char>& blob)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    const std::string temp = std::format("{}.{}.tmp", path, std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+        if (!out)
+        {
+            out.close();
+            std::filesystem::remove(temp, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp, path, error);
+    if (error)
+    {
+        std::error_code ignored;
+        std::filesystem::remove(temp, ignored);
+        return false;
+    }
+    return true;
+}
+
+CachedMesh PrepareCachedMesh(const MeshKey& key)
+{
+    CachedMesh mesh;
+    const std::string path = MeshCachePath(key);
+
+    if (mesh.file.Open(path))
+    {
+        if (ViewBlob(mesh.file.Data(), mesh.file.Size(), key, mesh))
+        {
+            mesh.fromCache = true;
+            TraceLog(LOG_INFO, "Mesh cache: %s mapped (%d vertices)", path.c_str(), mesh.vertexCount);
+            return mesh;
+        }
+        TraceLog(LOG_INFO, "Mesh cache: %s is stale, generating it again", path.c_str());
+        mesh = CachedMesh{};
+    }
+
+    Mesh generated = GenerateMeshData(key);
+    if (generated.vertexCount == 0)
+    {
+        TraceLog(LOG_ERROR, "Mesh cache: cannot generate %s", path.c_str());
+        return mesh;
+    }
+    mesh.blob = BuildBlob(key, generated);
+    FreeMeshData(generated);
+
+    ViewBlob(mesh.blob.data(), mesh.blob.size(), key, mesh);
+    if (WriteBlob(path, mesh.blob))
+        TraceLog(LOG_INFO, "Mesh cache: %s written (%zu bytes)", path.c_str(), mesh.blob.size());
+    else
+        TraceLog(LOG_WARNING, "Mesh cache: cannot write %s, the mesh is generated again next launch", path.c_str());
+    return mesh;
+}
+
+// The same attribute locations and vboId slots as UploadMesh, so DrawMeshInstanced and the
+// shaders see an ordinary raylib mesh; only the normal and texcoord formats differ
+Mesh UploadCachedMesh(CachedMesh& cached)
+{
+    Mesh mesh = { 0 };
+    if (cached.vertexCount == 0)
+        return mesh;
+
+    const bool quantized = cached.format == MeshVertexFormat::Quantized16;
+    mesh.vertexCount = cached.vertexCount;
+    mesh.triangleCount = cached.triangleCount;
+    mesh.vboId = static_cast<unsigned int*>(MemAlloc(MESH_VBO_SLOTS * sizeof(unsigned int)));
+
+    mesh.vaoId = rlLoadVertexArray();
+    rlEnableVertexArray(mesh.vaoId);
+
+    mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION] = rlLoadVertexBuffer(cached.positions, static_cast<int>(mesh.vertexCount * 3 * sizeof(float)), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 3, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+
+    // normalized integer attributes: the vertex shader still reads floats in [0, 1] and [-1, 1]
+    mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD] = rlLoadVertexBuffer(cached.texcoords, static_cast<int>(TexcoordBytes(cached.format, mesh.vertexCount)), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, 2, quantized ? RL_UNSIGNED_SHORT : RL_FLOAT, quantized, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD);
+
+    mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL] = rlLoadVertexBuffer(cached.normals, static_cast<int>(NormalBytes(cached.format, mesh.vertexCount)), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL, 3, quantized ? RL_SHORT : RL_FLOAT, quantized, quantized ? static_cast<int>(4 * sizeof(int16_t)) : 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL);
+
+    // no vertex colors: a constant white, as UploadMesh sets
+    const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    rlSetVertexAttributeDefault(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, white, SHADER_ATTRIB_VEC4, 4);
+    rlDisableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+
+    mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES] = rlLoadVertexBufferElement(cached.indices, static_cast<int>(mesh.triangleCount * 3 * sizeof(unsigned short)), false);
+    rlDisableVertexArray();
+
+    const size_t indexBytes = mesh.triangleCount * 3 * sizeof(unsigned short);
+    mesh.indices = static_cast<unsigned short*>(MemAlloc(static_cast<unsigned int>(indexBytes)));
+    std::memcpy(mesh.indices, cached.indices, indexBytes);
+
+    cached = CachedMesh{};
+    return mesh;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "raylib.h"
+#include "mapped_file.h"
+#include "procedural_mesh.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --- Generated-mesh cache.
+// Procedural meshes are generated once and kept as binary blobs under MESH_CACHE_DIR, one file
+// per generator version, parameters and vertex format. Later launches map the blob and upload
+// straight from the mapping: no generation, no parse, no copy of the vertex data. A blob whose
+// header does not match what was asked for (other version, other key, truncated write) is
+// generated again.
+//
+// Quantized16 keeps positions as floats and stores normals as snorm16 (x, y, z, 0) and texcoords
+// as unorm16, 24 bytes a vertex instead of 32: less to fetch per vertex of every instance in
+// DrawMeshInstanced. The GPU expands them back to floats, so the shaders do not change; texcoords
+// are clamped to [0, 1]. The attributes are set up on the mesh's VAO, which needs the GL 3.3
+// backend (without VAOs raylib would rebind the buffers as floats).
+//
+//     CachedMesh data = PrepareCachedMesh(SphereMeshKey(1.f, 32, 32, MeshVertexFormat::Quantized16)); // any thread
+//     Mesh mesh = UploadCachedMesh(data);                                                              // GL thread
+//
+// The uploaded Mesh has no CPU copy of its vertices, only of its indices (DrawMeshInstanced looks
+// at them to pick an indexed draw): it is for drawing, UnloadMesh frees it as usual.
+
+#define MESH_CACHE_DIR "cache/meshes"
+
+enum class MeshGenerator : uint32_t
+{
+    Sphere = 1, // GenSphereMeshData(radius, rings, slices)
+};
+
+enum class MeshVertexFormat : uint32_t
+{
+    Float32 = 0,     // float normals and texcoords, the layout UploadMesh uses
+    Quantized16 = 1, // snorm16 normals and unorm16 texcoords
+};
+
+// Everything a generated mesh depends on; the cache is keyed by all of it
+struct MeshKey
+{
+    MeshGenerator generator = MeshGenerator::Sphere;
+    uint32_t generatorVersion = 0; // the generator's *_MESH_GENERATOR_VERSION, so edited code is not hidden by old blobs
+    float params[3] = {}; // Sphere: radius, rings, slices
+    MeshVertexFormat format = MeshVertexFormat::Float32;
+};
+
+inline MeshKey SphereMeshKey(float radius, int rings, int slices, MeshVertexFormat format)
+{
+    return { MeshGenerator::Sphere, SPHERE_MESH_GENERATOR_VERSION, { radius, static_cast<float>(rings), static_cast<float>(slices) }, format };
+}
+
+// CPU side of a cached mesh. The arrays point into the mapped cache file, or into the blob just
+// generated when there was no usable one.
+struct CachedMesh
+{
+    MeshVertexFormat format = MeshVertexFormat::Float32;
+    int vertexCount = 0; // 0: nothing could be generated
+    int triangleCount = 0;
+    const float* positions = nullptr; // 3 floats a vertex
+    const void* normals = nullptr;    // 3 floats, or 4 int16 (x, y, z, 0) when quantized
+    const void* texcoords = nullptr;  // 2 floats, or 2 uint16 when quantized
+    const unsigned short* indices = nullptr;
+    bool fromCache = false;
+
+    MappedFile file;
+    std::vector<unsigned char> blob;
+};
+
+// Cache file of a key, under MESH_CACHE_DIR
+std::string MeshCachePath(const MeshKey& key);
+
+// Maps the cached blob, or generates the mesh and writes its blob. Touches no GL state, any thread.
+CachedMesh PrepareCachedMesh(const MeshKey& key);
+
+// Uploads to a new VAO and releases the CPU side (and the mapping). GL thread.
+Mesh UploadCachedMesh(CachedMesh& cached);
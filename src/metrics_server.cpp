@@ -0,0 +1,194 @@
+#include "metrics_server.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+static const SocketHandle INVALID_HANDLE = INVALID_SOCKET;
+static void CloseSocket(SocketHandle s) { closesocket(s); }
+static const int SEND_FLAGS = 0; // no SIGPIPE on Windows
+static int PollReadable(SocketHandle s, int timeoutMs)
+{
+    WSAPOLLFD fd = { s, POLLRDNORM, 0 };
+    return WSAPoll(&fd, 1, timeoutMs);
+}
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+static const SocketHandle INVALID_HANDLE = -1;
+static void CloseSocket(SocketHandle s) { close(s); }
+// A scraper that hangs up mid-response must not raise SIGPIPE, whose default action ends the
+// process: MSG_NOSIGNAL per send where it exists, SO_NOSIGPIPE on the socket on macOS
+#if defined(MSG_NOSIGNAL)
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+static int PollReadable(SocketHandle s, int timeoutMs)
+{
+    pollfd fd = { s, POLLIN, 0 };
+    return poll(&fd, 1, timeoutMs);
+}
+#endif
+
+// Logging goes through stderr, this file does not see raylib
+#define METRICS_LOG(...) std::fprintf(stderr, "[metrics] " __VA_ARGS__)
+
+static std::thread g_metricsThread;
+static std::atomic<bool> g_metricsStopping{ false };
+static SocketHandle g_listenSocket = INVALID_HANDLE;
+
+// The server copies the pointer under the lock and writes without it
+static std::mutex g_metricsTextMutex;
+static std::shared_ptr<const std::string> g_metricsText = std::make_shared<const std::string>();
+
+static void SendAll(SocketHandle client, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        const int n = send(client, data.data() + sent, static_cast<int>(data.size() - sent), SEND_FLAGS);
+        if (n <= 0)
+            return;
+        sent += static_cast<size_t>(n);
+    }
+}
+
+static void ServeClient(SocketHandle client)
+{
+    // the request line is all we look at; give a slow client a second at most
+    char request[2048];
+    int received = 0;
+    while (received < static_cast<int>(sizeof(request)) - 1 && PollReadable(client, 1000) > 0)
+    {
+        const int n = recv(client, request + received, static_cast<int>(sizeof(request)) - 1 - received, 0);
+        if (n <= 0)
+            break;
+        received += n;
+        request[received] = '\0';
+        if (std::strstr(request, "\r\n\r\n"))
+            break;
+    }
+    request[received] = '\0';
+
+    std::string response;
+    if (std::strncmp(request, "GET /metrics", 12) == 0)
+    {
+        std::shared_ptr<const std::string> text;
+        {
+            std::lock_guard<std::mutex> lock(g_metricsTextMutex);
+            text = g_metricsText;
+        }
+        response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\nContent-Length: "
+            + std::to_string(text->size()) + "\r\n\r\n" + *text;
+    }
+    else
+    {
+        response = "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    }
+    SendAll(client, response);
+    CloseSocket(client);
+}
+
+static void MetricsServerLoop()
+{
+    while (!g_metricsStopping)
+    {
+        // wake up regularly to notice StopMetricsServer
+        if (PollReadable(g_listenSocket, 200) <= 0)
+            continue;
+
+        const SocketHandle client = accept(g_listenSocket, nullptr, nullptr);
+        if (client == INVALID_HANDLE)
+            continue;
+#if defined(SO_NOSIGPIPE)
+        const int noSigPipe = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+        ServeClient(client);
+    }
+}
+
+bool StartMetricsServer(int port)
+{
+    if (MetricsServerRunning())
+        return true;
+
+#if defined(_WIN32)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        METRICS_LOG("WSAStartup failed\n");
+        return false;
+    }
+#endif
+
+    g_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (g_listenSocket == INVALID_HANDLE)
+    {
+        METRICS_LOG("socket() failed\n");
+        return false;
+    }
+
+    const int reuse = 1;
+    setsockopt(g_listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // local scrapers only
+    if (bind(g_listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(g_listenSocket, 4) != 0)
+    {
+        METRICS_LOG("cannot listen on 127.0.0.1:%d\n", port);
+        CloseSocket(g_listenSocket);
+        g_listenSocket = INVALID_HANDLE;
+        return false;
+    }
+
+    g_metricsStopping = false;
+    g_metricsThread = std::thread(MetricsServerLoop);
+    METRICS_LOG("serving http://127.0.0.1:%d/metrics\n", port);
+    return true;
+}
+
+void StopMetricsServer()
+{
+    if (!MetricsServerRunning())
+        return;
+
+    g_metricsStopping = true;
+    g_metricsThread.join();
+    CloseSocket(g_listenSocket);
+    g_listenSocket = INVALID_HANDLE;
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+bool MetricsServerRunning()
+{
+    return g_metricsThread.joinable();
+}
+
+bool PublishMetrics(std::string text)
+{
+    auto published = std::make_shared<const std::string>(std::move(text));
+    std::unique_lock<std::mutex> lock(g_metricsTextMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+
+    g_metricsText.swap(published);
+    lock.unlock();
+    return true; // the previous text is released here, or by the scrape still holding it
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+// --- Prometheus-style metrics endpoint on localhost.
+// A background thread serves GET /metrics on 127.0.0.1:port with whatever text was published
+// last. The simulation only ever hands over a finished string: PublishMetrics never waits for
+// a scraper, it drops the update when a scrape is copying the previous text at that instant.
+// The socket code lives in metrics_server.cpp so the OS headers stay away from raylib's.
+
+// Binds and starts the server thread; false (and a log line) if the port cannot be bound
+bool StartMetricsServer(int port);
+void StopMetricsServer();
+bool MetricsServerRunning();
+
+// Replaces the exposition text (Prometheus text format 0.0.4); false if the update was dropped
+bool PublishMetrics(std::string text);
@@ -0,0 +1,113 @@
+#include "particle_renderer.h"
+#include "raymath.h"
+#include "rlgl.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+#ifndef RL_UNSIGNED_BYTE
+#define RL_UNSIGNED_BYTE 0x1401 // GL_UNSIGNED_BYTE
+#endif
+
+// Attribute names of the sprite shader, in PARTICLE_RENDERER_COLUMNS order
+static const char* const COLUMN_ATTRIBUTES[PARTICLE_RENDERER_COLUMNS] = {
+    "instancePosX", "instancePosY", "instancePosZ", "instanceSize", "instanceAge", "instanceLife", "instanceColor",
+};
+
+// Two triangles, corners in [-0.5, 0.5]; the shader scales them by the particle size
+static const float QUAD_CORNERS[12] = {
+    -0.5f, -0.5f,  0.5f, -0.5f,  0.5f, 0.5f,
+    -0.5f, -0.5f,  0.5f,  0.5f, -0.5f, 0.5f,
+};
+
+ParticleRenderer LoadParticleRenderer(const char* vsSource, const char* fsSource)
+{
+    ParticleRenderer renderer;
+    renderer.shader = LoadShaderFromMemory(vsSource, fsSource);
+    renderer.locCorner = GetShaderLocationAttrib(renderer.shader, "vertexCorner");
+    for (int column = 0; column < PARTICLE_RENDERER_COLUMNS; ++column)
+    {
+        renderer.locColumns[column] = GetShaderLocationAttrib(renderer.shader, COLUMN_ATTRIBUTES[column]);
+    }
+    renderer.locViewProjection = GetShaderLocation(renderer.shader, "mvp");
+    renderer.locCameraRight = GetShaderLocation(renderer.shader, "cameraRight");
+    renderer.locCameraUp = GetShaderLocation(renderer.shader, "cameraUp");
+
+    if (renderer.locCorner < 0 || std::find(std::begin(renderer.locColumns), std::end(renderer.locColumns), -1) != std::end(renderer.locColumns))
+    {
+        TraceLog(LOG_ERROR, "Particle renderer: the sprite shader is missing its attributes, particles are not drawn");
+        return renderer;
+    }
+
+    renderer.vao = rlLoadVertexArray();
+    rlEnableVertexArray(renderer.vao);
+    renderer.cornerBuffer = rlLoadVertexBuffer(QUAD_CORNERS, sizeof(QUAD_CORNERS), false);
+    rlSetVertexAttribute(renderer.locCorner, 2, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(renderer.locCorner);
+    rlDisableVertexArray();
+    return renderer;
+}
+
+// (Re)creates the column buffers for at least count particles, with the VAO bound
+static void ReserveColumns(ParticleRenderer& renderer, int count)
+{
+    if (count <= renderer.capacity)
+        return;
+
+    renderer.capacity = std::max({ count, renderer.capacity * 2, 4096 });
+    rlEnableVertexArray(renderer.vao);
+    for (int column = 0; column < PARTICLE_RENDERER_COLUMNS; ++column)
+    {
+        if (renderer.columnBuffers[column] != 0)
+            rlUnloadVertexBuffer(renderer.columnBuffers[column]);
+
+        // every column is 4 bytes a particle: a float, or the RGBA8 color read as a normalized vec4
+        const bool color = column == PARTICLE_RENDERER_COLUMNS - 1;
+        const int location = renderer.locColumns[column];
+        renderer.columnBuffers[column] = rlLoadVertexBuffer(nullptr, renderer.capacity * 4, true);
+        rlSetVertexAttribute(location, color ? 4 : 1, color ? RL_UNSIGNED_BYTE : RL_FLOAT, color, 0, 0);
+        rlEnableVertexAttribute(location);
+        rlSetVertexAttributeDivisor(location, 1);
+    }
+    rlDisableVertexArray();
+}
+
+void DrawParticlesInstanced(ParticleRenderer& renderer, const ParticleSystem& particles, Texture2D texture, const Camera3D& camera)
+{
+    const int count = particles.Count();
+    if (count == 0 || renderer.vao == 0)
+        return;
+
+    ReserveColumns(renderer, count);
+    const void* columns[PARTICLE_RENDERER_COLUMNS] = {
+        particles.posX.data(), particles.posY.data(), particles.posZ.data(),
+        particles.size.data(), particles.age.data(), particles.life.data(), particles.color.data(),
+    };
+    for (int column = 0; column < PARTICLE_RENDERER_COLUMNS; ++column)
+    {
+        rlUpdateVertexBuffer(renderer.columnBuffers[column], columns[column], count * 4, 0);
+    }
+
+    // whatever the default batch holds was queued under its own state, draw it first
+    rlDrawRenderBatchActive();
+
+    const Matrix view = GetCameraMatrix(camera);
+    const Vector3 right = { view.m0, view.m4, view.m8 };
+    const Vector3 up = { view.m1, view.m5, view.m9 };
+    const Matrix viewProjection = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+
+    rlEnableShader(renderer.shader.id);
+    rlSetUniformMatrix(renderer.locViewProjection, viewProjection);
+    rlSetUniform(renderer.locCameraRight, &right, RL_SHADER_UNIFORM_VEC3, 1);
+    rlSetUniform(renderer.locCameraUp, &up, RL_SHADER_UNIFORM_VEC3, 1);
+    rlActiveTextureSlot(0);
+    rlEnableTexture(texture.id);
+
+    rlEnableVertexArray(renderer.vao);
+    rlDrawVertexArrayInstanced(0, 6, count);
+    rlDisableVertexArray();
+
+    rlDisableTexture();
+    rlDisableShader();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "raylib.h"
+#include "particles.h"
+
+// --- Instanced particle sprites.
+// All live particles in one instanced draw of a camera-facing quad. The ParticleSystem's SoA
+// columns are uploaded as they are, one vertex buffer each with an attribute divisor of 1, so
+// the CPU copies each column once per frame and builds no vertices: the vertex shader
+// places the corners, and fades the color with age / life.
+//
+//     ParticleRenderer renderer = LoadParticleRenderer(vsSource, fsSource);      // GL thread
+//     DrawParticlesInstanced(renderer, particles, texture, camera);            // inside BeginMode3D
+//
+// Needs instancing (GL 3.3, or GLES2 with the instanced arrays extension), as DrawMeshInstanced.
+
+// position x, y, z, size, age, life and color, in that attribute order
+#define PARTICLE_RENDERER_COLUMNS 7
+
+struct ParticleRenderer
+{
+    Shader shader = { 0 };
+    unsigned int vao = 0;
+    unsigned int cornerBuffer = 0;
+    unsigned int columnBuffers[PARTICLE_RENDERER_COLUMNS] = {};
+    int capacity = 0; // particles the column buffers hold, grown on demand
+
+    int locCorner = -1;
+    int locColumns[PARTICLE_RENDERER_COLUMNS] = { -1, -1, -1, -1, -1, -1, -1 };
+    int locViewProjection = -1;
+    int locCameraRight = -1;
+    int locCameraUp = -1;
+};
+
+// Compiles the sprite shader and creates the quad; the column buffers come with the first draw.
+// GL thread.
+ParticleRenderer LoadParticleRenderer(const char* vsSource, const char* fsSource);
+
+// Uploads particles [0, Count()) and draws them with texture, in the current blend mode. Call
+// between BeginMode3D and EndMode3D. GL thread.
+void DrawParticlesInstanced(ParticleRenderer& renderer, const ParticleSystem& particles, Texture2D texture, const Camera3D& camera);
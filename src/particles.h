@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "job_pool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define PARTICLES_USE_SSE 1
+#endif
+
+// One particle to add, written by emitters on any thread
+struct ParticleEmit
+{
+    float x, y, z;
+    float vx, vy, vz;
+    float life;     // seconds
+    float size;
+    uint32_t color; // RGBA8, r in the low byte
+};
+
+// --- Cosmetic particles, kept out of the ECS. Fixed capacity SoA pool: the update is a
+// straight SIMD pass over float arrays on the job pool, dead particles are swap-removed
+// afterwards, and emitters append to per-thread staging lists that are drained at the start of
+// the next update. Nothing here touches a Flecs table.
+class ParticleSystem
+{
+public:
+    explicit ParticleSystem(int capacity = 1 << 20)
+        : capacity((capacity + 3) & ~3)
+    {
+    }
+
+    // One staging list per emitting thread; emitters pass their flecs stage id or job pool index
+    void SetEmitterThreads(int threadCount)
+    {
+        pending.resize(std::max(threadCount, 1));
+    }
+
+    void Emit(int threadIndex, const ParticleEmit& emit)
+    {
+        pending[threadIndex].push_back(emit);
+    }
+
+    // Appends the staged particles, integrates every live one and drops the expired ones
+    void Update(float deltaTime, float gravity, float drag, JobPool& pool)
+    {
+        AppendPending();
+        if (count == 0)
+            return;
+
+        const float damping = std::exp(-drag * deltaTime);
+        const int blocks = (count + 3) / 4; // storage is padded to 4, the tail lanes are scratch
+        pool.ParallelFor(blocks, 1024, [&](int begin, int end)
+        {
+            Integrate(begin * 4, end * 4, deltaTime, gravity, damping);
+        });
+
+        Compact();
+    }
+
+    void Clear()
+    {
+        count = 0;
+        for (std::vector<ParticleEmit>& staged : pending)
+        {
+            staged.clear();
+        }
+    }
+
+    int Count() const { return count; }
+    int Capacity() const { return capacity; }
+    long long Dropped() const { return dropped; }
+
+    // live particles are [0, Count())
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> velX, velY, velZ;
+    std::vector<float> age, life, size;
+    std::vector<uint32_t> color;
+
+private:
+    void EnsureStorage()
+    {
+        if (!posX.empty())
+            return;
+
+        for (std::vector<float>* column : { &posX, &posY, &posZ, &velX, &velY, &velZ, &age, &life, &size })
+        {
+            column->resize(capacity, 0.0f);
+        }
+        color.resize(capacity, 0);
+    }
+
+    void AppendPending()
+    {
+        for (std::vector<ParticleEmit>& staged : pending)
+        {
+            if (staged.empty())
+                continue;
+
+            EnsureStorage();
+            for (const ParticleEmit& emit : staged)
+            {
+                if (count == capacity)
+                {
+                    ++dropped;
+                    continue;
+                }
+
+                const int i = count++;
+                posX[i] = emit.x; posY[i] = emit.y; posZ[i] = emit.z;
+                velX[i] = emit.vx; velY[i] = emit.vy; velZ[i] = emit.vz;
+                age[i] = 0.0f;
+                life[i] = emit.life;
+                size[i] = emit.size;
+                color[i] = emit.color;
+            }
+            staged.clear();
+        }
+    }
+
+    // [begin, end) is a multiple of 4 and within the padded storage
+    void Integrate(int begin, int end, float deltaTime, float gravity, float damping)
+    {
+#if PARTICLES_USE_SSE
+        const __m128 dt = _mm_set1_ps(deltaTime);
+        const __m128 damp = _mm_set1_ps(damping);
+        const __m128 gravityStep = _mm_set1_ps(gravity * deltaTime);
+        for (int i = begin; i < end; i += 4)
+        {
+            const __m128 vx = _mm_mul_ps(_mm_loadu_ps(&velX[i]), damp);
+            const __m128 vy = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&velY[i]), damp), gravityStep);
+            const __m128 vz = _mm_mul_ps(_mm_loadu_ps(&velZ[i]), damp);
+            _mm_storeu_ps(&velX[i], vx);
+            _mm_storeu_ps(&velY[i], vy);
+            _mm_storeu_ps(&velZ[i], vz);
+            _mm_storeu_ps(&posX[i], _mm_add_ps(_mm_loadu_ps(&posX[i]), _mm_mul_ps(vx, dt)));
+            _mm_storeu_ps(&posY[i], _mm_add_ps(_mm_loadu_ps(&posY[i]), _mm_mul_ps(vy, dt)));
+            _mm_storeu_ps(&posZ[i], _mm_add_ps(_mm_loadu_ps(&posZ[i]), _mm_mul_ps(vz, dt)));
+            _mm_storeu_ps(&age[i], _mm_add_ps(_mm_loadu_ps(&age[i]), dt));
+        }
+#else
+        // same shape as the SSE path, left for the compiler to vectorize
+        const float gravityStep = gravity * deltaTime;
+        for (int i = begin; i < end; ++i)
+        {
+            velX[i] *= damping;
+            velY[i] = velY[i] * damping - gravityStep;
+            velZ[i] *= damping;
+            posX[i] += velX[i] * deltaTime;
+            posY[i] += velY[i] * deltaTime;
+            posZ[i] += velZ[i] * deltaTime;
+            age[i] += deltaTime;
+        }
+#endif
+    }
+
+    // Moves the last live particle into every expired slot; order is irrelevant for additive sprites
+    void Compact()
+    {
+        int i = 0;
+        while (i < count)
+        {
+            if (age[i] < life[i])
+            {
+                ++i;
+                continue;
+            }
+
+            const int last = --count;
+            posX[i] = posX[last]; posY[i] = posY[last]; posZ[i] = posZ[last];
+            velX[i] = velX[last]; velY[i] = velY[last]; velZ[i] = velZ[last];
+            age[i] = age[last];
+            life[i] = life[last];
+            size[i] = size[last];
+            color[i] = color[last];
+        }
+    }
+
+    int capacity;
+    int count = 0;
+    long long dropped = 0;
+    std::vector<std::vector<ParticleEmit>> pending = std::vector<std::vector<ParticleEmit>>(1);
+};
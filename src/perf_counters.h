@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// --- Hardware performance counters for the calling thread (Linux perf_event_open).
+// One group per thread, led by the cycle counter, so a single read() returns every counter
+// consistently. Counters the CPU or the VM does not expose are left out of the group; when even
+// the leader cannot be opened (no PMU, perf_event_paranoid, seccomp, other OS) the group is
+// unavailable, Read() returns zeros and FailureReason() says why.
+enum PerfCounter : int
+{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+inline const char* PerfCounterName(int counter)
+{
+    static const char* names[PERF_COUNTER_COUNT] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+    return names[counter];
+}
+
+struct PerfSample
+{
+    uint64_t values[PERF_COUNTER_COUNT] = {};
+};
+
+class PerfCounterGroup
+{
+public:
+    PerfCounterGroup()
+    {
+#if defined(__linux__)
+        for (int& fd : fds)
+        {
+            fd = -1;
+        }
+
+        fds[PERF_CYCLES] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (fds[PERF_CYCLES] < 0)
+        {
+            failure = std::string("perf_event_open: ") + std::strerror(errno);
+            return;
+        }
+        fds[PERF_INSTRUCTIONS] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, fds[PERF_CYCLES]);
+        fds[PERF_L1D_MISSES] = Open(PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), fds[PERF_CYCLES]);
+        fds[PERF_LLC_MISSES] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, fds[PERF_CYCLES]);
+        fds[PERF_BRANCH_MISSES] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, fds[PERF_CYCLES]);
+
+        // group reads return values in the order the members were opened
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter)
+        {
+            if (fds[counter] >= 0)
+                slotOf[counter] = members++;
+        }
+
+        ioctl(fds[PERF_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[PERF_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+        failure = "hardware counters are only implemented on Linux";
+#endif
+    }
+
+    ~PerfCounterGroup()
+    {
+#if defined(__linux__)
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+#endif
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    bool Available() const { return failure.empty(); }
+    bool Has(int counter) const { return slotOf[counter] >= 0; }
+    const std::string& FailureReason() const { return failure; }
+
+    // Running totals since the group was opened; subtract two reads to measure a region
+    PerfSample Read() const
+    {
+        PerfSample sample;
+#if defined(__linux__)
+        if (!Available())
+            return sample;
+
+        uint64_t buffer[1 + PERF_COUNTER_COUNT] = {};
+        if (read(fds[PERF_CYCLES], buffer, sizeof(buffer)) <= 0)
+            return sample;
+
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter)
+        {
+            if (slotOf[counter] >= 0 && slotOf[counter] < static_cast<int>(buffer[0]))
+                sample.values[counter] = buffer[1 + slotOf[counter]];
+        }
+#endif
+        return sample;
+    }
+
+    // The calling thread's group, opened on first use
+    static PerfCounterGroup& ForThisThread()
+    {
+        thread_local PerfCounterGroup group;
+        return group;
+    }
+
+private:
+#if defined(__linux__)
+    static int Open(uint32_t type, uint64_t config, int groupFd)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = groupFd < 0 ? 1 : 0; // the leader enables the whole group
+        attr.exclude_kernel = 1;             // allowed at perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+    }
+
+    int fds[PERF_COUNTER_COUNT];
+#endif
+    int slotOf[PERF_COUNTER_COUNT] = { -1, -1, -1, -1, -1 };
+    int members = 0;
+    std::string failure;
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "flecs.h"
+
+// --- Periodic jobs on staggered tick sources.
+// Work that does not have to run every frame (stats, GUI counts, LOD re-tagging) is declared as
+// an ordinary system with .tick_source() set to a source from EveryNthFrame() or Every(). The
+// sources are plain entities holding flecs::TickSource that Advance() writes once per frame, so
+// the pipeline skips those systems on the frames they do not fire, exactly like a rate filter.
+// The difference is the phase: Flecs rate filters and timers all count from the same frame and
+// line up every time their periods do. Here a frame job takes the least loaded offset when it
+// is declared, and an interval job that comes due on a frame that is already busy waits a few
+// frames for a quiet one.
+class PeriodicScheduler
+{
+public:
+    static constexpr int LOAD_HORIZON = 240;   // frames covered by the offset table
+    static constexpr int MAX_JOBS_PER_FRAME = 1;
+    static constexpr int MAX_DEFER_FRAMES = 4; // an interval job never waits longer than this
+
+    // Source that fires every period frames. Names are looked up in the current scope; declaring
+    // a name that is already scheduled returns its source unchanged, so a module can re-declare
+    // its systems (hot reload) without doubling its jobs.
+    flecs::entity EveryNthFrame(flecs::world& world, const char* name, int period)
+    {
+        if (const Job* existing = Find(world, name))
+            return existing->source;
+
+        Job job;
+        job.source = MakeSource(world, name);
+        job.period = std::clamp(period, 1, LOAD_HORIZON);
+        job.offset = LeastLoadedOffset(job.period);
+        for (int frame = job.offset; frame < LOAD_HORIZON; frame += job.period)
+        {
+            ++frameLoad[frame];
+        }
+        jobs.push_back(job);
+        return job.source;
+    }
+
+    // Source that fires about every seconds, shifted by up to MAX_DEFER_FRAMES to avoid busy frames
+    flecs::entity Every(flecs::world& world, const char* name, float seconds)
+    {
+        if (const Job* existing = Find(world, name))
+            return existing->source;
+
+        Job job;
+        job.source = MakeSource(world, name);
+        job.interval = std::max(seconds, 0.0f);
+        job.due = time + job.interval;
+        jobs.push_back(job);
+        return job.source;
+    }
+
+    // Sets the tick flag of every source for this frame. Must run before the scheduled systems.
+    void Advance(float deltaTime)
+    {
+        time += deltaTime;
+        firedLastFrame = 0;
+
+        for (Job& job : jobs)
+        {
+            job.elapsed += deltaTime;
+            if (job.period > 0)
+            {
+                Fire(job, frame % job.period == job.offset);
+            }
+        }
+
+        for (Job& job : jobs)
+        {
+            if (job.period > 0 || time < job.due)
+                continue;
+
+            const bool fire = firedLastFrame < MAX_JOBS_PER_FRAME || job.deferred >= MAX_DEFER_FRAMES;
+            if (fire)
+            {
+                // a long hitch does not turn into a burst of catch-up ticks
+                job.due = std::max(job.due + job.interval, time);
+                job.deferred = 0;
+            }
+            else
+            {
+                ++job.deferred;
+            }
+            Fire(job, fire);
+        }
+
+        ++frame;
+    }
+
+    int JobCount() const { return static_cast<int>(jobs.size()); }
+    int FiredLastFrame() const { return firedLastFrame; }
+
+private:
+    struct Job
+    {
+        flecs::entity source;
+        int period = 0;       // frame jobs, 0 for interval jobs
+        int offset = 0;
+        float interval = 0.0f; // interval jobs
+        double due = 0.0;
+        int deferred = 0;
+        float elapsed = 0.0f; // time since the last tick, handed to the systems as delta_system_time
+    };
+
+    static flecs::entity MakeSource(flecs::world& world, const char* name)
+    {
+        return world.entity(name).set<flecs::TickSource>({ false, 0.0f });
+    }
+
+    const Job* Find(flecs::world& world, const char* name) const
+    {
+        const flecs::entity source = world.lookup(name);
+        if (!source.is_valid())
+            return nullptr;
+
+        const auto it = std::find_if(jobs.begin(), jobs.end(), [&](const Job& job) { return job.source == source; });
+        return it != jobs.end() ? &*it : nullptr;
+    }
+
+    int LeastLoadedOffset(int period) const
+    {
+        int bestOffset = 0;
+        int bestLoad = -1;
+        for (int offset = 0; offset < period; ++offset)
+        {
+            int load = 0;
+            for (int frame = offset; frame < LOAD_HORIZON; frame += period)
+            {
+                load = std::max(load, frameLoad[frame]);
+            }
+            if (bestLoad < 0 || load < bestLoad)
+            {
+                bestLoad = load;
+                bestOffset = offset;
+            }
+        }
+        return bestOffset;
+    }
+
+    void Fire(Job& job, bool fire)
+    {
+        flecs::TickSource& tick = job.source.get_mut<flecs::TickSource>();
+        tick.tick = fire;
+        tick.time_elapsed = fire ? job.elapsed : 0.0f;
+        if (fire)
+        {
+            job.elapsed = 0.0f;
+            ++firedLastFrame;
+        }
+    }
+
+    std::vector<Job> jobs;
+    int frameLoad[LOAD_HORIZON] = {};
+    long long frame = 0;
+    double time = 0.0;
+    int firedLastFrame = 0;
+};
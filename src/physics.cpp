@@ -0,0 +1,1331 @@
+#include "simulation_internal.h"
+#include "fixed_point.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// --- Physics module systems ---
+// LOD re-tagging, the collision kernels, the contact solver, SPH forces and integration: the
+// systems of the Physics module, in a translation unit of their own so that ENABLE_HOT_RELOAD
+// can build them as the MyProjectPhysics module and reload them into a running app. State that
+// must survive a reload (broadphase, fluid grid, job pool, statistics) and the kernels' work
+// buffers are the world's, owned by simulation.cpp, see simulation_internal.h.
+
+// LOD bodies are re-tagged every few frames, a boundary crossing is picked up slightly late;
+// the LodBand reach covers what a body travels in between
+static const int SIM_LOD_ASSIGN_PERIOD = 8;
+
+// Radius/mass lookup for the collision kernels. The primary template reads the Radius and Mass
+// components; the Uniform specialization is the homogeneous fast path where every entity is
+// GameState::entitySize with unit mass and no component is touched, which also lets the
+// compiler fold the mass-weighted overlap split back into the plain half/half split.
+template<RadiusModel Model>
+struct EntityShape
+{
+    static float RadiusOf(const GameState&, const Radius& r) { return r.value; }
+    static float MassOf(const Mass& m) { return m.value; }
+};
+
+template<>
+struct EntityShape<RadiusModel::Uniform>
+{
+    static float RadiusOf(const GameState& game_state, const Radius&) { return game_state.entitySize; }
+    static float MassOf(const Mass&) { return 1.0f; }
+};
+
+// Contacts of one color share no body, so a color is solved in parallel without atomics.
+// Contacts that find no free color among the first MAX_CONTACT_COLORS go to a serial batch.
+static const int MAX_CONTACT_COLORS = 64;
+
+// Level 0 takes the untagged bodies, the others their tag and tick source
+template<typename Builder>
+static void ApplySimLod(Builder& builder, const SimLod& lod)
+{
+    if (lod.level == 0)
+    {
+        builder.template without<LodMid>().template without<LodFar>();
+        return;
+    }
+
+    if (lod.level == 1)
+        builder.template with<LodMid>();
+    else
+        builder.template with<LodFar>();
+    builder.tick_source(lod.tickSource);
+}
+
+// Frames between two steps of a level, and so the most substeps its collision passes take
+static int SimLodRate(int level)
+{
+    return level == 0 ? 1 : (level == 1 ? SIM_LOD_MID_RATE : SIM_LOD_FAR_RATE);
+}
+
+// Time the entity is owed since it was last integrated, clamped as a frame at the slowest rate
+static float OwedStepTime(double simTime, const SimClock& clock)
+{
+    return static_cast<float>(std::min(simTime - clock.lastStep, 0.33 * SIM_LOD_FAR_RATE));
+}
+
+struct BounceSystem
+{
+};
+void DeclareDetectGridEntityCollision(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod)
+{
+    auto system = world.system<Position, Velocity, const Radius, CollisionResponse>(LodSystemName("DetectGridEntity", lod).c_str());
+    ApplySimLod(system, lod);
+    system
+        .kind(inPhase)
+        .read<Position>()
+        .read<Velocity>()
+        .read<Radius>()
+        .write<CollisionResponse>()
+        .each([&](Position& p, Velocity& v, const Radius& radius, CollisionResponse& resp)
+        {
+            const GameState& game_state = world.get<GameState>();
+            const float entitySize = game_state.radiusModel == RadiusModel::PerEntity ? radius.value : game_state.entitySize;
+            bool bounced = false;
+            Vector3 normal{ 0, 0, 0 };
+            Vector3 posFix{ 0, 0, 0 };
+
+            // Left
+            if (p.value.x - entitySize < -game_state.gridSize && v.value.x < 0)
+            {
+                float overlap = (-game_state.gridSize + entitySize) - p.value.x;
+                posFix.x += overlap;
+                normal = Vector3Add(normal, Vector3{ 1, 0, 0 });
+                bounced = true;
+            }
+            // Right
+            if (p.value.x + entitySize > game_state.gridSize && v.value.x > 0)
+            {
+                float overlap = (game_state.gridSize - entitySize) - p.value.x;
+                posFix.x += overlap;
+                normal = Vector3Add(normal, Vector3{ -1, 0, 0 });
+                bounced = true;
+            }
+            // Bottom
+            if (p.value.y - entitySize < -game_state.gridSize && v.value.y < 0)
+            {
+                float overlap = (-game_state.gridSize + entitySize) - p.value.y;
+                posFix.y += overlap;
+                normal = Vector3Add(normal, Vector3{ 0, 1, 0 });
+                bounced = true;
+            }
+            // Top
+            if (p.value.y + entitySize > game_state.gridSize && v.value.y > 0)
+            {
+                float overlap = (game_state.gridSize - entitySize) - p.value.y;
+                posFix.y += overlap;
+                normal = Vector3Add(normal, Vector3{ 0, -1, 0 });
+                bounced = true;
+            }
+            // Back and front, the arena is a cube in 3D
+            if (game_state.dimensions == 3)
+            {
+                if (p.value.z - entitySize < -game_state.gridSize && v.value.z < 0)
+                {
+                    posFix.z += (-game_state.gridSize + entitySize) - p.value.z;
+                    normal = Vector3Add(normal, Vector3{ 0, 0, 1 });
+                    bounced = true;
+                }
+                if (p.value.z + entitySize > game_state.gridSize && v.value.z > 0)
+                {
+                    posFix.z += (game_state.gridSize - entitySize) - p.value.z;
+                    normal = Vector3Add(normal, Vector3{ 0, 0, -1 });
+                    bounced = true;
+                }
+            }
+
+            if (bounced)
+            {
+                // Normalize the combined normal if any component present
+                if (Vector3Length(normal) > 0.0f) normal = Vector3Normalize(normal);
+                // Compute reflected velocity; store as delta
+                Vector3 reflected = Vector3Reflect(v.value, normal);
+                resp.posDelta = Vector3Add(resp.posDelta, posFix);
+                resp.velDelta = Vector3Add(resp.velDelta, Vector3Subtract(reflected, v.value));
+                resp.hasCollision = true;
+            }
+        });
+}
+
+void DeclareMoveEntitiesSystem(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod)
+{
+    // System to update position based on velocity, over the time since the entity's last step
+    auto system = world.system<Position, const Velocity, SimClock>(LodSystemName("MoveEntities", lod).c_str());
+    ApplySimLod(system, lod);
+    system
+		.multi_threaded()
+        .kind(inPhase)
+		.read<Velocity>()
+		.write<Position>()
+		.write<SimClock>()
+        .run([&](flecs::iter& it)
+        {
+            const double simTime = world.get<SimTime>().seconds;
+            while (it.next())
+            {
+                auto p = it.field<Position>(0);
+                auto v = it.field<const Velocity>(1);
+                auto clock = it.field<SimClock>(2);
+                for (auto i : it)
+                {
+                    const float stepTime = OwedStepTime(simTime, clock[i]);
+                    clock[i].lastStep = simTime;
+                    p[i].value = Vector3Add(p[i].value, Vector3Scale(v[i].value, stepTime));
+                }
+            }
+        });
+}
+
+// Advances SimTime and, every few frames, re-tags bodies whose distance to the focus crossed
+// an LOD boundary or the band around one
+void DeclareSimLodSystems(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("AdvanceSimTime")
+        .kind(inPhase)
+        .each([&]()
+        {
+            world.ensure<SimTime>().seconds += std::min(world.delta_time(), 0.33f);
+        });
+
+    world.system<const Position>("AssignSimLod")
+        .multi_threaded()
+        .kind(inPhase)
+        .tick_source(GetSimulationState(world).periodicJobs.EveryNthFrame(world, "SimLodAssignTick", SIM_LOD_ASSIGN_PERIOD))
+        .with<SimClock>()
+        .each([&](flecs::entity e, const Position& p)
+        {
+            const GameState& game_state = world.get<GameState>();
+            int level = 0;
+            bool band = false;
+            if (game_state.simulationLod)
+            {
+                const float distance = Vector3Distance(p.value, game_state.lodFocus);
+                level = distance > game_state.lodFarRadius ? 2 : (distance > game_state.lodNearRadius ? 1 : 0);
+
+                // a cell, plus what two bodies closing in cover until the next re-tag or far step
+                const float frames = static_cast<float>(std::max(SIM_LOD_ASSIGN_PERIOD, SIM_LOD_FAR_RATE));
+                const float reach = GetCellSize(game_state) + 2.0f * game_state.entitySpeed * std::min(world.delta_time(), 0.33f) * frames;
+                band = std::abs(distance - game_state.lodNearRadius) < reach || std::abs(distance - game_state.lodFarRadius) < reach;
+            }
+
+            // deferred, and only structural when the level actually changed
+            const bool mid = e.has<LodMid>();
+            const bool far = e.has<LodFar>();
+            if (mid != (level == 1))
+            {
+                if (level == 1) e.add<LodMid>(); else e.remove<LodMid>();
+            }
+            if (far != (level == 2))
+            {
+                if (level == 2) e.add<LodFar>(); else e.remove<LodFar>();
+            }
+            if (e.has<LodBand>() != band)
+            {
+                if (band) e.add<LodBand>(); else e.remove<LodBand>();
+            }
+        });
+}
+
+// --- Compile-time collision policy ---
+// Dimensionality, broadphase, radius model and precision are fixed for a given scene, so the
+// collision kernels are templates over a CollisionPolicy and DispatchCollisionPolicy picks the
+// instantiation once per system run. Each variant is a plain loop over SoA arrays with no
+// GameState reads or runtime branching on the scene setup inside it.
+template<int Dim, BroadphaseKind BP, RadiusModel RM, typename Scalar>
+struct CollisionPolicy
+{
+    static_assert(Dim == 2 || Dim == 3, "collision kernels are 2D or 3D");
+
+    static constexpr int dimensions = Dim;
+    static constexpr BroadphaseKind broadphase = BP;
+    static constexpr RadiusModel radiusModel = RM;
+    using Real = Scalar;
+    using Shape = EntityShape<RM>;
+};
+
+template<int Dim, BroadphaseKind BP, RadiusModel RM, typename Fn>
+static void DispatchPrecision(const GameState& game_state, Fn& fn)
+{
+    if (game_state.precision == Precision::Double)
+    {
+        fn.template operator()<CollisionPolicy<Dim, BP, RM, double>>();
+    }
+    else if (game_state.precision == Precision::FixedContacts)
+    {
+        fn.template operator()<CollisionPolicy<Dim, BP, RM, Fixed>>();
+    }
+    else
+    {
+        fn.template operator()<CollisionPolicy<Dim, BP, RM, float>>();
+    }
+}
+
+template<int Dim, BroadphaseKind BP, typename Fn>
+static void DispatchRadiusModel(const GameState& game_state, Fn& fn)
+{
+    if (game_state.radiusModel == RadiusModel::PerEntity)
+    {
+        DispatchPrecision<Dim, BP, RadiusModel::PerEntity>(game_state, fn);
+    }
+    else
+    {
+        DispatchPrecision<Dim, BP, RadiusModel::Uniform>(game_state, fn);
+    }
+}
+
+template<int Dim, typename Fn>
+static void DispatchBroadphase(const GameState& game_state, Fn& fn)
+{
+    if (game_state.broadphase == BroadphaseKind::SortedGrid)
+    {
+        DispatchRadiusModel<Dim, BroadphaseKind::SortedGrid>(game_state, fn);
+    }
+    else
+    {
+        DispatchRadiusModel<Dim, BroadphaseKind::HashBuckets>(game_state, fn);
+    }
+}
+
+// Calls fn.template operator()<Policy>() with the policy matching the scene setup
+template<typename Fn>
+static void DispatchCollisionPolicy(const GameState& game_state, Fn&& fn)
+{
+    if (game_state.dimensions == 3)
+    {
+        DispatchBroadphase<3>(game_state, fn);
+    }
+    else
+    {
+        DispatchBroadphase<2>(game_state, fn);
+    }
+}
+
+// Radius of a body under the policy's radius model; Uniform never touches the array
+template<typename Policy>
+struct BodyRadius
+{
+    using Real = typename Policy::Real;
+
+    const CollisionBodies<Real>& bodies;
+    Real uniform;
+
+    Real operator()(int body) const
+    {
+        if constexpr (Policy::radiusModel == RadiusModel::PerEntity)
+        {
+            return bodies.radius[body];
+        }
+        else
+        {
+            return uniform;
+        }
+    }
+};
+
+// Deterministic mode: table order, and with it gather order, depends on which worker's deferred
+// commands were merged first. With the bodies in entity id order, the broadphase buckets, the
+// contact lists and the coloring no longer depend on it.
+template<typename Real>
+static void SortBodiesById(CollisionBodies<Real>& bodies)
+{
+    const int count = bodies.Count();
+    std::vector<int>& order = bodies.order;
+    order.resize(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return bodies.id[a] < bodies.id[b]; });
+
+    const auto permute = [&](auto& values, auto& sorted)
+    {
+        if (values.empty())
+            return; // posZ, velZ and radius are only filled by some policies
+        sorted.resize(values.size());
+        for (int k = 0; k < count; ++k)
+        {
+            sorted[k] = values[order[k]];
+        }
+        values.swap(sorted);
+    };
+    std::vector<Real>& sortedReal = bodies.sortedReal;
+    permute(bodies.posX, sortedReal); permute(bodies.posY, sortedReal); permute(bodies.posZ, sortedReal);
+    permute(bodies.velX, sortedReal); permute(bodies.velY, sortedReal); permute(bodies.velZ, sortedReal);
+    permute(bodies.radius, sortedReal);
+    permute(bodies.invMass, sortedReal);
+    permute(bodies.restitution, sortedReal);
+    permute(bodies.step, sortedReal);
+    permute(bodies.ghost, bodies.sortedFlag);
+    permute(bodies.cellX, bodies.sortedInt); permute(bodies.cellY, bodies.sortedInt); permute(bodies.cellZ, bodies.sortedInt);
+    permute(bodies.id, bodies.sortedId);
+
+    bodies.slotOf.resize(count);
+    for (int k = 0; k < count; ++k)
+    {
+        bodies.slotOf[order[k]] = k;
+    }
+}
+
+// LodBand bodies of every level, which the passes of the other levels gather as ghosts. Terms:
+// Position, Velocity, SpatialCell, Radius, Mass, Restitution, LodBand, then LodMid and LodFar
+// optional to tell the level.
+using LodBandQuery = flecs::query<const Position, const Velocity, const SpatialCell, const Radius, const Mass, const Restitution>;
+
+static LodBandQuery BuildLodBandQuery(flecs::world& world)
+{
+    return world.query_builder<const Position, const Velocity, const SpatialCell, const Radius, const Mass, const Restitution>()
+        .with<LodBand>()
+        .with<LodMid>().optional()
+        .with<LodFar>().optional()
+        .cache_kind(flecs::QueryCacheAuto)
+        .build();
+}
+
+template<typename Policy>
+static void PushCollisionBody(CollisionBodies<typename Policy::Real>& bodies, const GameState& game_state, const Position& p, const Velocity& v,
+    const SpatialCell& sc, const Radius& radius, const Mass& m, const Restitution& e)
+{
+    using Real = typename Policy::Real;
+    using Shape = typename Policy::Shape;
+
+    bodies.posX.push_back(static_cast<Real>(p.value.x));
+    bodies.posY.push_back(static_cast<Real>(p.value.y));
+    bodies.velX.push_back(static_cast<Real>(v.value.x));
+    bodies.velY.push_back(static_cast<Real>(v.value.y));
+    if constexpr (Policy::dimensions == 3)
+    {
+        bodies.posZ.push_back(static_cast<Real>(p.value.z));
+        bodies.velZ.push_back(static_cast<Real>(v.value.z));
+    }
+    if constexpr (Policy::radiusModel == RadiusModel::PerEntity)
+    {
+        bodies.radius.push_back(static_cast<Real>(Shape::RadiusOf(game_state, radius)));
+    }
+    const float mass = Shape::MassOf(m);
+    bodies.invMass.push_back(mass > 0.0f ? Real(1) / static_cast<Real>(mass) : Real(0));
+    bodies.restitution.push_back(static_cast<Real>(e.value));
+    bodies.cellX.push_back(sc.cellX);
+    bodies.cellY.push_back(sc.cellY);
+    if constexpr (Policy::dimensions == 3)
+        bodies.cellZ.push_back(sc.cellZ);
+}
+
+// Terms of every collision system, in this order:
+// Position, Velocity, SpatialCell, Radius, Mass, Restitution, CollisionResponse, SimClock
+// Gathers the level's bodies, then the other levels' LodBand bodies as ghosts when LOD is on.
+// Returns the substeps the level's step takes: enough that no body travels more than its radius
+// in one, at most one per frame of the level's rate, so level 0 always takes a single one.
+template<typename Policy>
+static int GatherCollisionBodies(flecs::iter& it, const LodBandQuery& band, const GameState& game_state, CollisionBodies<typename Policy::Real>& bodies, int level, double simTime)
+{
+    using Real = typename Policy::Real;
+    using Shape = typename Policy::Shape;
+
+    bodies.Clear();
+    bodies.level = level;
+    float travel = 0.0f; // in radii
+    while (it.next())
+    {
+        auto p = it.field<Position>(0);
+        auto v = it.field<Velocity>(1);
+        auto sc = it.field<const SpatialCell>(2);
+        auto radius = it.field<const Radius>(3);
+        auto m = it.field<const Mass>(4);
+        auto e = it.field<const Restitution>(5);
+        auto r = it.field<CollisionResponse>(6);
+        auto clock = it.field<SimClock>(7);
+
+        bodies.chunks.push_back({ &p[0], &v[0], &r[0], &clock[0], static_cast<int>(it.count()) });
+        for (auto i : it)
+        {
+            PushCollisionBody<Policy>(bodies, game_state, p[i], v[i], sc[i], radius[i], m[i], e[i]);
+            const float owed = OwedStepTime(simTime, clock[i]);
+            bodies.step.push_back(static_cast<Real>(owed));
+            bodies.ghost.push_back(0);
+            if (game_state.deterministic)
+                bodies.id.push_back(it.entity(i).id());
+
+            const float bodyRadius = Shape::RadiusOf(game_state, radius[i]);
+            if (bodyRadius > 0.0f)
+                travel = std::max(travel, Vector3Length(v[i].value) * owed / bodyRadius);
+        }
+    }
+
+    if (game_state.simulationLod)
+    {
+        band.run([&](flecs::iter& ghosts)
+        {
+            while (ghosts.next())
+            {
+                const int ghostLevel = ghosts.is_set(8) ? 2 : (ghosts.is_set(7) ? 1 : 0);
+                if (ghostLevel == level)
+                    continue;
+
+                auto p = ghosts.field<const Position>(0);
+                auto v = ghosts.field<const Velocity>(1);
+                auto sc = ghosts.field<const SpatialCell>(2);
+                auto radius = ghosts.field<const Radius>(3);
+                auto m = ghosts.field<const Mass>(4);
+                auto e = ghosts.field<const Restitution>(5);
+                for (auto i : ghosts)
+                {
+                    PushCollisionBody<Policy>(bodies, game_state, p[i], v[i], sc[i], radius[i], m[i], e[i]);
+                    bodies.step.push_back(Real(0));
+                    bodies.ghost.push_back(static_cast<uint8_t>(1 + ghostLevel));
+                    if (game_state.deterministic)
+                        bodies.id.push_back(ghosts.entity(i).id());
+                }
+            }
+        });
+    }
+
+    const int substeps = std::clamp(static_cast<int>(std::ceil(travel)), 1, SimLodRate(level));
+    if (substeps > 1)
+    {
+        for (Real& step : bodies.step) step = step / Real(substeps);
+    }
+
+    if (game_state.deterministic)
+        SortBodiesById(bodies);
+    return substeps;
+}
+
+// Moves the level's own bodies one substep on inside the kernel and re-buckets them; with
+// bounceOffWalls they also bounce off the arena walls as DetectGridEntity would. Ghosts have no
+// step and stay where they are.
+template<typename Policy>
+static void AdvanceSubstep(SimulationState& state, CollisionBodies<typename Policy::Real>& bodies, const BodyRadius<Policy>& radiusOf, const GameState& game_state, bool bounceOffWalls)
+{
+    using Real = typename Policy::Real;
+    constexpr bool is3D = Policy::dimensions == 3;
+    const Real wall = static_cast<Real>(game_state.gridSize);
+    const float cellSize = GetCellSize(game_state);
+
+    GetJobPool(state).ParallelFor(bodies.Count(), 1024, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            if (bodies.ghost[i])
+                continue;
+
+            const Real step = bodies.step[i];
+            bodies.posX[i] += bodies.velX[i] * step;
+            bodies.posY[i] += bodies.velY[i] * step;
+            if constexpr (is3D) bodies.posZ[i] += bodies.velZ[i] * step;
+
+            if (bounceOffWalls)
+            {
+                const Real radius = radiusOf(i);
+                const auto bounce = [&](Real& pos, Real& vel)
+                {
+                    if (pos - radius < -wall && vel < Real(0))
+                    {
+                        pos = radius - wall;
+                        vel = -vel;
+                    }
+                    if (pos + radius > wall && vel > Real(0))
+                    {
+                        pos = wall - radius;
+                        vel = -vel;
+                    }
+                };
+                bounce(bodies.posX[i], bodies.velX[i]);
+                bounce(bodies.posY[i], bodies.velY[i]);
+                if constexpr (is3D) bounce(bodies.posZ[i], bodies.velZ[i]);
+            }
+
+            const Vector3 position = {
+                static_cast<float>(bodies.posX[i]),
+                static_cast<float>(bodies.posY[i]),
+                is3D ? static_cast<float>(bodies.posZ[i]) : 0.0f
+            };
+            const SpatialCell cell = ComputeCell(position, cellSize, is3D);
+            bodies.cellX[i] = cell.cellX;
+            bodies.cellY[i] = cell.cellY;
+            if constexpr (is3D) bodies.cellZ[i] = cell.cellZ;
+        }
+    });
+}
+
+// Writes the level's own bodies back. After substeps the kernel moved them itself: Position and
+// Velocity take the state the last substep started from, and the clock the time already covered,
+// so MoveEntities only integrates the last substep. The solver writes them back either way.
+template<typename Policy>
+static void WriteBackBodies(const CollisionBodies<typename Policy::Real>& bodies, int substeps, bool writeBodies)
+{
+    int body = 0;
+    for (const auto& chunk : bodies.chunks)
+    {
+        for (int i = 0; i < chunk.count; ++i, ++body)
+        {
+            const int b = bodies.SlotOf(body);
+            if (writeBodies || substeps > 1)
+            {
+                chunk.v[i].value.x = static_cast<float>(bodies.velX[b]);
+                chunk.v[i].value.y = static_cast<float>(bodies.velY[b]);
+                chunk.p[i].value.x = static_cast<float>(bodies.posX[b]);
+                chunk.p[i].value.y = static_cast<float>(bodies.posY[b]);
+                if constexpr (Policy::dimensions == 3)
+                {
+                    chunk.v[i].value.z = static_cast<float>(bodies.velZ[b]);
+                    chunk.p[i].value.z = static_cast<float>(bodies.posZ[b]);
+                }
+            }
+            if (substeps > 1)
+                chunk.clock[i].lastStep += static_cast<double>(bodies.step[b]) * (substeps - 1);
+        }
+    }
+}
+
+template<typename Policy>
+static BroadphaseGrid<Policy::broadphase>& BuildBroadphase(SimulationState& state, const CollisionBodies<typename Policy::Real>& bodies, const GameState& game_state)
+{
+    BroadphaseGrid<Policy::broadphase>& grid = GetBroadphase<Policy::broadphase>(state);
+    grid.Build(bodies.cellX, bodies.cellY, bodies.cellZ, game_state.gridSize, GetCellSize(game_state));
+    return grid;
+}
+
+// std::sqrt for float and double, the integer square root of fixed_point.h for Fixed
+template<typename Real>
+static inline Real SqrtReal(Real x)
+{
+    using std::sqrt;
+    return sqrt(x);
+}
+
+// Offset from body b to body a and its squared length, z only in 3D
+template<typename Policy>
+struct PairOffset
+{
+    using Real = typename Policy::Real;
+
+    Real dx, dy, dz, d2;
+
+    PairOffset(const CollisionBodies<Real>& bodies, int a, int b)
+        : dx(bodies.posX[a] - bodies.posX[b])
+        , dy(bodies.posY[a] - bodies.posY[b])
+        , dz(0)
+    {
+        if constexpr (Policy::dimensions == 3)
+        {
+            dz = bodies.posZ[a] - bodies.posZ[b];
+        }
+        d2 = dx * dx + dy * dy + dz * dz;
+    }
+};
+
+// --- One-shot response ---
+// Each body accumulates its own response against all of its neighbours: reflect the velocity
+// and take its inverse-mass share of the overlap (half for equal masses). Bodies only write
+// their own slot, so the loop runs on the job pool; every pair is simply tested from both sides.
+// In deterministic mode the neighbours are summed in id order rather than in the order the
+// broadphase visits them. Ghosts only take part as neighbours.
+template<typename Policy>
+static void ComputeOneShotResponses(SimulationState& state, CollisionBodies<typename Policy::Real>& bodies, const BroadphaseGrid<Policy::broadphase>& grid,
+    const BodyRadius<Policy>& radiusOf, const GameState& game_state)
+{
+    using Real = typename Policy::Real;
+
+    const int count = bodies.Count();
+    bodies.dPosX.assign(count, Real(0)); bodies.dPosY.assign(count, Real(0)); bodies.dPosZ.assign(count, Real(0));
+    bodies.dVelX.assign(count, Real(0)); bodies.dVelY.assign(count, Real(0)); bodies.dVelZ.assign(count, Real(0));
+
+    const bool emitSparks = game_state.collisionEffect != CollisionEffect::None;
+    const bool deterministic = game_state.deterministic;
+    ReductionPass<int>* contactStats = GetContactStatsPass(state);
+    GetJobPool(state).ParallelFor(count, 256, [&](int begin, int end, int threadIndex)
+    {
+        thread_local std::vector<int> neighbours;
+        int contacts = 0;
+        for (int i = begin; i < end; ++i)
+        {
+            if (bodies.ghost[i])
+                continue;
+
+            const Real radius = radiusOf(i);
+            Real dpx = 0, dpy = 0, dpz = 0;
+            Real dvx = 0, dvy = 0, dvz = 0;
+            bool hit = false;
+
+            const auto accumulate = [&](int j)
+            {
+                if (j == i) return;
+
+                const PairOffset<Policy> offset(bodies, i, j);
+                const Real requiredDistance = radius + radiusOf(j);
+                if (offset.d2 >= requiredDistance * requiredDistance) return;
+
+                const Real distance = SqrtReal(offset.d2);
+                Real nx = 1, ny = 0, nz = 0;
+                if (distance > Real(0))
+                {
+                    nx = offset.dx / distance;
+                    ny = offset.dy / distance;
+                    nz = offset.dz / distance;
+                }
+
+                Real share = Real(0.5);
+                if constexpr (Policy::radiusModel == RadiusModel::PerEntity)
+                {
+                    share = bodies.invMass[i] / (bodies.invMass[i] + bodies.invMass[j]);
+                }
+                const Real push = (requiredDistance - distance) * share;
+                dpx += nx * push;
+                dpy += ny * push;
+                dpz += nz * push;
+
+                // reflect about the normal: v' - v = -2 (v.n) n
+                Real vn = bodies.velX[i] * nx + bodies.velY[i] * ny;
+                if constexpr (Policy::dimensions == 3)
+                {
+                    vn += bodies.velZ[i] * nz;
+                }
+                dvx -= Real(2) * vn * nx;
+                dvy -= Real(2) * vn * ny;
+                dvz -= Real(2) * vn * nz;
+                hit = true;
+
+                // one burst per approaching pair, emitted by the lower index only (a pair with a
+                // ghost is tested from one side here, the finer level's pass reports it)
+                const bool reported = (i < j || bodies.ghost[j]) && bodies.Reports(i, j);
+                if (reported) ++contacts;
+                if (emitSparks && reported)
+                {
+                    Real closing = (bodies.velX[i] - bodies.velX[j]) * nx + (bodies.velY[i] - bodies.velY[j]) * ny;
+                    if constexpr (Policy::dimensions == 3)
+                    {
+                        closing += (bodies.velZ[i] - bodies.velZ[j]) * nz;
+                    }
+                    if (closing < Real(0))
+                    {
+                        const Vector3 contact = {
+                            static_cast<float>(bodies.posX[i] - nx * radius),
+                            static_cast<float>(bodies.posY[i] - ny * radius),
+                            Policy::dimensions == 3 ? static_cast<float>(bodies.posZ[i] - nz * radius) : 0.0f
+                        };
+                        EmitCollisionEffect(state, threadIndex, game_state, contact);
+                    }
+                }
+            };
+
+            if (deterministic)
+            {
+                neighbours.clear();
+                grid.ForEachCandidate(i, [&](int j) { neighbours.push_back(j); });
+                std::sort(neighbours.begin(), neighbours.end());
+                for (int j : neighbours) accumulate(j);
+            }
+            else
+            {
+                grid.ForEachCandidate(i, accumulate);
+            }
+
+            bodies.dPosX[i] = dpx; bodies.dPosY[i] = dpy; bodies.dPosZ[i] = dpz;
+            bodies.dVelX[i] = dvx; bodies.dVelY[i] = dvy; bodies.dVelZ[i] = dvz;
+            if (hit) bodies.touched[i] = 1;
+        }
+        if (contactStats)
+            contactStats->Accumulate(threadIndex, contacts);
+    });
+}
+
+// A level stepped in substeps applies the responses and moves its bodies in place for all but
+// the last one, which goes through CollisionResponse and MoveEntities like a single step does
+template<typename Policy>
+static void RunOneShotCollision(flecs::iter& it, const LodBandQuery& band, SimulationState& state, const GameState& game_state, int level, double simTime)
+{
+    using Real = typename Policy::Real;
+    constexpr bool is3D = Policy::dimensions == 3;
+
+    CollisionBodies<Real>& bodies = GetCollisionBodies<Real>(state);
+    const int substeps = GatherCollisionBodies<Policy>(it, band, game_state, bodies, level, simTime);
+    const BodyRadius<Policy> radiusOf{ bodies, static_cast<Real>(game_state.entitySize) };
+
+    const int count = bodies.Count();
+    bodies.touched.assign(count, 0); // hit in any substep
+    for (int substep = 0; substep < substeps; ++substep)
+    {
+        const BroadphaseGrid<Policy::broadphase>& grid = BuildBroadphase<Policy>(state, bodies, game_state);
+        ComputeOneShotResponses<Policy>(state, bodies, grid, radiusOf, game_state);
+        if (substep == substeps - 1)
+            break;
+
+        for (int i = 0; i < count; ++i)
+        {
+            bodies.posX[i] += bodies.dPosX[i]; bodies.posY[i] += bodies.dPosY[i];
+            bodies.velX[i] += bodies.dVelX[i]; bodies.velY[i] += bodies.dVelY[i];
+            if constexpr (is3D)
+            {
+                bodies.posZ[i] += bodies.dPosZ[i];
+                bodies.velZ[i] += bodies.dVelZ[i];
+            }
+        }
+        AdvanceSubstep<Policy>(state, bodies, radiusOf, game_state, true);
+    }
+
+    WriteBackBodies<Policy>(bodies, substeps, false);
+
+    int body = 0;
+    for (const auto& chunk : bodies.chunks)
+    {
+        for (int i = 0; i < chunk.count; ++i, ++body)
+        {
+            const int b = bodies.SlotOf(body);
+            if (!bodies.touched[b]) continue;
+
+            CollisionResponse& resp = chunk.r[i];
+            resp.posDelta = Vector3Add(resp.posDelta, { static_cast<float>(bodies.dPosX[b]), static_cast<float>(bodies.dPosY[b]), static_cast<float>(bodies.dPosZ[b]) });
+            resp.velDelta = Vector3Add(resp.velDelta, { static_cast<float>(bodies.dVelX[b]), static_cast<float>(bodies.dVelY[b]), static_cast<float>(bodies.dVelZ[b]) });
+            resp.hasCollision = true;
+        }
+    }
+}
+
+void DeclareDetectEntitiesCollision(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod)
+{
+    // Broadphase collision: record responses instead of directly mutating P/V, which are only
+    // written when the level's step is split into substeps
+    const LodBandQuery band = BuildLodBandQuery(world);
+    auto system = world.system<Position, Velocity, const SpatialCell, const Radius, const Mass, const Restitution, CollisionResponse, SimClock>(
+        LodSystemName("DetectEntitiesCollision", lod).c_str());
+    ApplySimLod(system, lod);
+    system
+        .kind(inPhase) // parallelism comes from the job pool inside the kernel
+        .read<SpatialCell>()
+        .read<Radius>()
+        .read<Mass>()
+        .write<Position>()
+        .write<Velocity>()
+        .write<CollisionResponse>()
+        .write<SimClock>()
+        .run([&world, band, level = lod.level](flecs::iter& it)
+        {
+            const GameState& game_state = world.get<GameState>();
+            SimulationState& state = GetSimulationState(world);
+            const double simTime = world.get<SimTime>().seconds;
+            DispatchCollisionPolicy(game_state, [&]<typename Policy>()
+            {
+                RunOneShotCollision<Policy>(it, band, state, game_state, level, simTime);
+            });
+        });
+ }
+
+// Pass 1: density and pressure per particle. Each particle only writes its own slot.
+void DeclareComputeFluidDensitySystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<const FluidParticle>("ComputeFluidDensity")
+        .multi_threaded()
+        .kind(inPhase)
+        .read<FluidParticle>()
+        .run([&](flecs::iter& it)
+        {
+            // once per run and worker, not per particle
+            const GameState& game_state = world.get<GameState>();
+            FluidGrid& grid = GetFluidGrid(GetSimulationState(world));
+            const FluidKernel kernel(game_state.fluidSmoothingRadius);
+            const float densityScale = game_state.fluidParticleMass * kernel.poly6;
+
+            while (it.next())
+            {
+                auto particles = it.field<const FluidParticle>(0);
+                for (auto i : it)
+                {
+                    const FluidParticle& fp = particles[i];
+                    const int slot = grid.cells.slotOf[fp.gridIndex];
+                    const float xi = grid.posX[slot];
+                    const float yi = grid.posY[slot];
+
+                    float sum = 0.0f;
+                    grid.cells.ForEachNeighbourSlot(grid.cells.cellOf[fp.gridIndex], [&](int j)
+                    {
+                        const float dx = xi - grid.posX[j];
+                        const float dy = yi - grid.posY[j];
+                        const float r2 = dx * dx + dy * dy;
+                        if (r2 < kernel.h2)
+                        {
+                            const float d = kernel.h2 - r2;
+                            sum += d * d * d;
+                        }
+                    });
+
+                    const float density = densityScale * sum;
+                    grid.density[slot] = density;
+                    // clamp negative pressure to avoid particles clumping together
+                    grid.pressure[slot] = std::max(game_state.fluidStiffness * (density - game_state.fluidRestDensity), 0.0f);
+                }
+            }
+        });
+}
+
+// Pass 2: pressure + viscosity forces, integrated into the particle's own Velocity.
+// Neighbour data is read from the snapshot only, so the pass is free of cross-entity writes.
+void DeclareApplyFluidForcesSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<Velocity, const FluidParticle>("ApplyFluidForces")
+        .multi_threaded()
+        .kind(inPhase)
+        .read<FluidParticle>()
+        .write<Velocity>()
+        .run([&](flecs::iter& it)
+        {
+            const GameState& game_state = world.get<GameState>();
+            const FluidGrid& grid = GetFluidGrid(GetSimulationState(world));
+            const FluidKernel kernel(game_state.fluidSmoothingRadius);
+            const float mass = game_state.fluidParticleMass;
+            const float clampedDeltaTime = std::min(world.delta_time(), 0.33f);
+
+            while (it.next())
+            {
+                auto velocities = it.field<Velocity>(0);
+                auto particles = it.field<const FluidParticle>(1);
+                for (auto i : it)
+                {
+                    Velocity& v = velocities[i];
+                    const FluidParticle& fp = particles[i];
+                    const int slot = grid.cells.slotOf[fp.gridIndex];
+                    const float xi = grid.posX[slot];
+                    const float yi = grid.posY[slot];
+                    const float vxi = grid.velX[slot];
+                    const float vyi = grid.velY[slot];
+                    const float pi = grid.pressure[slot];
+                    const float rhoi = grid.density[slot];
+                    if (rhoi <= 0.0f)
+                        continue;
+
+                    float fx = 0.0f;
+                    float fy = 0.0f;
+                    grid.cells.ForEachNeighbourSlot(grid.cells.cellOf[fp.gridIndex], [&](int j)
+                    {
+                        const float dx = xi - grid.posX[j];
+                        const float dy = yi - grid.posY[j];
+                        const float r2 = dx * dx + dy * dy;
+                        if (j == slot || r2 >= kernel.h2 || r2 <= 0.0f)
+                            return;
+
+                        const float r = std::sqrt(r2);
+                        const float rhoj = grid.density[j];
+                        const float w = kernel.h - r;
+
+                        // pressure pushes apart along the pair direction
+                        const float pressureTerm = mass * (pi + grid.pressure[j]) / (2.0f * rhoj) * kernel.spikyGrad * w * w;
+                        fx += dx / r * pressureTerm;
+                        fy += dy / r * pressureTerm;
+
+                        // viscosity pulls velocities towards the neighbours'
+                        const float viscTerm = game_state.fluidViscosity * mass / rhoj * kernel.viscLap * w;
+                        fx += (grid.velX[j] - vxi) * viscTerm;
+                        fy += (grid.velY[j] - vyi) * viscTerm;
+                    });
+
+                    v.value.x += fx / rhoi * clampedDeltaTime;
+                    v.value.y += (fy / rhoi - game_state.gravity) * clampedDeltaTime;
+
+                    // entitySpeed acts as the speed limit of the fluid, keeps stiff settings from exploding
+                    const float speed = Vector3Length(v.value);
+                    if (speed > game_state.entitySpeed && speed > 0.0f)
+                    {
+                        v.value = Vector3Scale(v.value, game_state.entitySpeed / speed);
+                    }
+                }
+            }
+        });
+}
+
+// --- Sequential impulse contact solver ---
+template<typename Policy>
+static void FindSolverContacts(ContactSolver<typename Policy::Real>& solver, const CollisionBodies<typename Policy::Real>& bodies,
+    const BroadphaseGrid<Policy::broadphase>& grid, const BodyRadius<Policy>& radiusOf, const GameState& game_state)
+{
+    using Real = typename Policy::Real;
+    const Real wall = static_cast<Real>(game_state.gridSize);
+    const int bodyCount = bodies.Count();
+
+    solver.contacts.clear();
+    for (int i = 0; i < bodyCount; ++i)
+    {
+        // ghosts are solved as the other bodies are, but only against the level's own bodies
+        const bool ghost = bodies.ghost[i] != 0;
+        const Real xi = bodies.posX[i];
+        const Real yi = bodies.posY[i];
+        const Real radius = radiusOf(i);
+
+        // arena walls as contacts against a static body, Z walls in 3D only
+        const auto addWall = [&](Real nx, Real ny, Real nz)
+        {
+            SolverContact<Real> c;
+            c.a = i;
+            c.nx = nx;
+            c.ny = ny;
+            c.nz = nz;
+            c.wallOffset = wall;
+            solver.contacts.push_back(c);
+        };
+        if (!ghost)
+        {
+            if (xi - radius < -wall) addWall(-1, 0, 0);
+            if (xi + radius > wall) addWall(1, 0, 0);
+            if (yi - radius < -wall) addWall(0, -1, 0);
+            if (yi + radius > wall) addWall(0, 1, 0);
+            if constexpr (Policy::dimensions == 3)
+            {
+                const Real zi = bodies.posZ[i];
+                if (zi - radius < -wall) addWall(0, 0, -1);
+                if (zi + radius > wall) addWall(0, 0, 1);
+            }
+        }
+
+        grid.ForEachCandidate(i, [&](int j)
+        {
+            if (j <= i) return; // process pair once
+            if (ghost && bodies.ghost[j]) return;
+
+            const PairOffset<Policy> offset(bodies, j, i);
+            const Real requiredDistance = radius + radiusOf(j);
+            if (offset.d2 >= requiredDistance * requiredDistance) return;
+
+            const Real d = SqrtReal(offset.d2);
+            SolverContact<Real> c;
+            c.a = i;
+            c.b = j;
+            c.nx = d > Real(0) ? offset.dx / d : Real(1);
+            c.ny = d > Real(0) ? offset.dy / d : Real(0);
+            c.nz = d > Real(0) ? offset.dz / d : Real(0);
+            solver.contacts.push_back(c);
+        });
+    }
+}
+
+// Greedy coloring: each contact takes the lowest color neither of its bodies uses yet
+template<typename Real>
+static int ColorSolverContacts(ContactSolver<Real>& solver)
+{
+    const size_t contactCount = solver.contacts.size();
+    std::fill(solver.usedColors.begin(), solver.usedColors.end(), 0ull);
+    solver.contactColor.resize(contactCount);
+    solver.colorStart.assign(MAX_CONTACT_COLORS + 2, 0);
+
+    int colorCount = 0;
+    for (size_t k = 0; k < contactCount; ++k)
+    {
+        const SolverContact<Real>& c = solver.contacts[k];
+        uint64_t used = solver.usedColors[c.a];
+        if (c.b >= 0) used |= solver.usedColors[c.b];
+
+        int color = MAX_CONTACT_COLORS; // serial batch
+        if (used != ~0ull)
+        {
+            color = 0;
+            while (used & (1ull << color)) ++color;
+
+            solver.usedColors[c.a] |= 1ull << color;
+            if (c.b >= 0) solver.usedColors[c.b] |= 1ull << color;
+            colorCount = std::max(colorCount, color + 1);
+        }
+        solver.contactColor[k] = static_cast<uint8_t>(color);
+        solver.colorStart[color + 1]++;
+    }
+
+    for (int color = 0; color <= MAX_CONTACT_COLORS; ++color)
+    {
+        solver.colorStart[color + 1] += solver.colorStart[color];
+    }
+
+    solver.colored.resize(contactCount);
+    std::vector<int> cursor(solver.colorStart.begin(), solver.colorStart.end() - 1);
+    for (size_t k = 0; k < contactCount; ++k)
+    {
+        solver.colored[cursor[solver.contactColor[k]]++] = solver.contacts[k];
+    }
+
+    return colorCount;
+}
+
+// Runs fn on every contact, color by color; contacts inside a color run on the job pool
+template<typename Real, typename Fn>
+static void ForEachContactByColor(JobPool& jobPool, ContactSolver<Real>& solver, Fn&& fn)
+{
+    for (int color = 0; color < MAX_CONTACT_COLORS; ++color)
+    {
+        const int begin = solver.colorStart[color];
+        const int count = solver.colorStart[color + 1] - begin;
+        jobPool.ParallelFor(count, 64, [&](int first, int last)
+        {
+            for (int k = first; k < last; ++k) fn(solver.colored[begin + k]);
+        });
+    }
+
+    for (int k = solver.colorStart[MAX_CONTACT_COLORS]; k < solver.colorStart[MAX_CONTACT_COLORS + 1]; ++k)
+    {
+        fn(solver.colored[k]);
+    }
+}
+
+// One solve per substep: gravity over the substep, contacts, velocity then position
+// iterations, and all but the last substep integrate the positions in place; MoveEntities
+// integrates the last one. Ghosts are solved with their mass so that each side of a boundary
+// takes its own share, and are never written back.
+template<typename Policy>
+static void RunContactSolver(flecs::iter& it, const LodBandQuery& band, SimulationState& state, const GameState& game_state, int level, double simTime)
+{
+    using Real = typename Policy::Real;
+    constexpr bool is3D = Policy::dimensions == 3;
+
+    CollisionBodies<Real>& bodies = GetCollisionBodies<Real>(state);
+    ContactSolver<Real>& solver = GetContactSolver<Real>(state);
+
+    const int substeps = GatherCollisionBodies<Policy>(it, band, game_state, bodies, level, simTime);
+    const BodyRadius<Policy> radiusOf{ bodies, static_cast<Real>(game_state.entitySize) };
+
+    const int bodyCount = bodies.Count();
+    solver.usedColors.resize(bodyCount);
+    solver.touched.assign(bodyCount, 0);
+
+    const auto normalVelocity = [&](const SolverContact<Real>& c)
+    {
+        Real rvx = -bodies.velX[c.a];
+        Real rvy = -bodies.velY[c.a];
+        Real rvz = is3D ? -bodies.velZ[c.a] : Real(0);
+        if (c.b >= 0)
+        {
+            rvx += bodies.velX[c.b];
+            rvy += bodies.velY[c.b];
+            if constexpr (is3D) rvz += bodies.velZ[c.b];
+        }
+        return rvx * c.nx + rvy * c.ny + rvz * c.nz;
+    };
+
+    JobPool& jobPool = GetJobPool(state);
+    const Real gravity = static_cast<Real>(game_state.gravity);
+    const bool emitSparks = game_state.collisionEffect != CollisionEffect::None;
+    for (int substep = 0; substep < substeps; ++substep)
+    {
+        // gravity is integrated into the velocity before solving
+        for (int i = 0; i < bodyCount; ++i)
+        {
+            bodies.velY[i] -= gravity * bodies.step[i];
+        }
+
+        const BroadphaseGrid<Policy::broadphase>& grid = BuildBroadphase<Policy>(state, bodies, game_state);
+        FindSolverContacts<Policy>(solver, bodies, grid, radiusOf, game_state);
+        if (game_state.deterministic)
+        {
+            // (min id, max id) order, bodies already being in id order; walls (b = -1) first. Makes
+            // the coloring, and so every impulse, independent of the broadphase's visiting order.
+            std::stable_sort(solver.contacts.begin(), solver.contacts.end(), [](const SolverContact<Real>& x, const SolverContact<Real>& y)
+            {
+                return x.a != y.a ? x.a < y.a : x.b < y.b;
+            });
+        }
+
+        // restitution target from the approach speed before any impulse is applied
+        int pairContacts = 0;
+        for (SolverContact<Real>& c : solver.contacts)
+        {
+            const bool reported = bodies.Reports(c.a, c.b);
+            if (c.b >= 0 && reported) ++pairContacts;
+            const Real approach = -normalVelocity(c);
+            const Real e = c.b >= 0 ? std::min(bodies.restitution[c.a], bodies.restitution[c.b]) : bodies.restitution[c.a];
+            c.bounce = approach > Real(0) ? e * approach : Real(0);
+            if (emitSparks && c.b >= 0 && reported && approach > Real(0))
+            {
+                const Real radius = radiusOf(c.a);
+                const Vector3 contact = {
+                    static_cast<float>(bodies.posX[c.a] + c.nx * radius),
+                    static_cast<float>(bodies.posY[c.a] + c.ny * radius),
+                    is3D ? static_cast<float>(bodies.posZ[c.a] + c.nz * radius) : 0.0f
+                };
+                EmitCollisionEffect(state, 0, game_state, contact);
+            }
+            solver.touched[c.a] = 1;
+            if (c.b >= 0) solver.touched[c.b] = 1;
+        }
+
+        if (ReductionPass<int>* contactStats = GetContactStatsPass(state))
+            contactStats->Accumulate(0, pairContacts);
+        const int colorCount = ColorSolverContacts(solver);
+        if (level == 0)
+        {
+            // the GUI shows the focus region's solve
+            state.collisionStats.contactCount = static_cast<int>(solver.contacts.size());
+            state.collisionStats.colorCount = colorCount;
+        }
+
+        for (int iteration = 0; iteration < game_state.solverVelocityIterations; ++iteration)
+        {
+            ForEachContactByColor(jobPool, solver, [&](SolverContact<Real>& c)
+            {
+                const Real invA = bodies.invMass[c.a];
+                const Real invB = c.b >= 0 ? bodies.invMass[c.b] : Real(0);
+                const Real k = invA + invB;
+                if (k <= Real(0)) return;
+
+                const Real previous = c.impulse;
+                c.impulse = std::max(previous + (c.bounce - normalVelocity(c)) / k, Real(0));
+                const Real lambda = c.impulse - previous;
+
+                bodies.velX[c.a] -= c.nx * lambda * invA;
+                bodies.velY[c.a] -= c.ny * lambda * invA;
+                if constexpr (is3D) bodies.velZ[c.a] -= c.nz * lambda * invA;
+                if (c.b >= 0)
+                {
+                    bodies.velX[c.b] += c.nx * lambda * invB;
+                    bodies.velY[c.b] += c.ny * lambda * invB;
+                    if constexpr (is3D) bodies.velZ[c.b] += c.nz * lambda * invB;
+                }
+            });
+        }
+
+        // push remaining penetration out so piles do not sink into each other
+        const Real correctionFactor = static_cast<Real>(game_state.solverPositionCorrection);
+        const Real slop = static_cast<Real>(game_state.solverPenetrationSlop);
+        for (int iteration = 0; iteration < game_state.solverPositionIterations; ++iteration)
+        {
+            ForEachContactByColor(jobPool, solver, [&](SolverContact<Real>& c)
+            {
+                const Real invA = bodies.invMass[c.a];
+                const Real invB = c.b >= 0 ? bodies.invMass[c.b] : Real(0);
+                const Real k = invA + invB;
+                if (k <= Real(0)) return;
+
+                Real penetration;
+                Real nx = c.nx, ny = c.ny, nz = c.nz;
+                if (c.b >= 0)
+                {
+                    const PairOffset<Policy> offset(bodies, c.b, c.a);
+                    const Real d = SqrtReal(offset.d2);
+                    if (d > Real(0))
+                    {
+                        nx = offset.dx / d;
+                        ny = offset.dy / d;
+                        nz = offset.dz / d;
+                    }
+                    penetration = radiusOf(c.a) + radiusOf(c.b) - d;
+                }
+                else
+                {
+                    penetration = bodies.posX[c.a] * nx + bodies.posY[c.a] * ny + radiusOf(c.a) - c.wallOffset;
+                    if constexpr (is3D) penetration += bodies.posZ[c.a] * nz;
+                }
+
+                const Real correction = correctionFactor * std::max(penetration - slop, Real(0)) / k;
+                bodies.posX[c.a] -= nx * correction * invA;
+                bodies.posY[c.a] -= ny * correction * invA;
+                if constexpr (is3D) bodies.posZ[c.a] -= nz * correction * invA;
+                if (c.b >= 0)
+                {
+                    bodies.posX[c.b] += nx * correction * invB;
+                    bodies.posY[c.b] += ny * correction * invB;
+                    if constexpr (is3D) bodies.posZ[c.b] += nz * correction * invB;
+                }
+            });
+        }
+
+        if (substep < substeps - 1)
+            AdvanceSubstep<Policy>(state, bodies, radiusOf, game_state, false);
+    }
+
+    WriteBackBodies<Policy>(bodies, substeps, true);
+
+    int body = 0;
+    for (const auto& chunk : bodies.chunks)
+    {
+        for (int i = 0; i < chunk.count; ++i, ++body)
+        {
+            if (solver.touched[bodies.SlotOf(body)])
+            {
+                chunk.r[i].hasCollision = true; // ApplyCollisionResponse recolors it
+            }
+        }
+    }
+}
+
+void DeclareSolveContactsSystem(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod)
+{
+    const LodBandQuery band = BuildLodBandQuery(world);
+    auto system = world.system<Position, Velocity, const SpatialCell, const Radius, const Mass, const Restitution, CollisionResponse, SimClock>(
+        LodSystemName("SolveContacts", lod).c_str());
+    ApplySimLod(system, lod);
+    system
+        .kind(inPhase)
+        .write<Position>()
+        .write<Velocity>()
+        .write<CollisionResponse>()
+        .write<SimClock>()
+        .run([&world, band, level = lod.level](flecs::iter& it)
+        {
+            const GameState& game_state = world.get<GameState>();
+            SimulationState& state = GetSimulationState(world);
+            const double simTime = world.get<SimTime>().seconds;
+            DispatchCollisionPolicy(game_state, [&]<typename Policy>()
+            {
+                RunContactSolver<Policy>(it, band, state, game_state, level, simTime);
+            });
+        });
+}
+
+
+// Apply accumulated responses and reset
+void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod)
+{
+    auto system = world.system<Position, Velocity, ColorComp, CollisionResponse>(LodSystemName("ApplyCollisionResponse", lod).c_str());
+    ApplySimLod(system, lod);
+    system
+        .kind(inPhase)
+        .write<Position>()
+        .write<Velocity>()
+        .write<ColorComp>()
+        .write<CollisionResponse>()
+        .each([&](Position& p, Velocity& v, ColorComp &c, CollisionResponse& resp)
+        {
+            if (!resp.hasCollision)
+                return;
+
+            p.value = Vector3Add(p.value, resp.posDelta);
+            v.value = Vector3Add(v.value, resp.velDelta);
+            c.value = GetRandomColor();
+
+            // reset accumulator
+            resp.posDelta = Vector3Zero();
+            resp.velDelta = Vector3Zero();
+            resp.hasCollision = false;
+        });
+ }
+
+void DeclarePhysicsSystems(flecs::world& world, const SimCore& core)
+{
+    // LOD levels: 0 every frame, the others from staggered periodic sources so mid and far
+    // never step on the same frame
+    const SimLod lods[] = {
+        { 0, {} },
+        { 1, GetSimulationState(world).periodicJobs.EveryNthFrame(world, "SimLodMidTick", SIM_LOD_MID_RATE) },
+        { 2, GetSimulationState(world).periodicJobs.EveryNthFrame(world, "SimLodFarTick", SIM_LOD_FAR_RATE) },
+    };
+    DeclareSimLodSystems(world, core.prePhysics);
+
+    // SPH: two multi-threaded passes over the grid SpatialIndex sorted, only enabled in fluid mode
+    DeclareComputeFluidDensitySystem(world, core.prePhysics);
+    DeclareApplyFluidForcesSystem(world, core.prePhysics);
+
+    // Per level: collide, apply the responses, integrate. A level's passes only run on its
+    // ticks and split its longer step into substeps; the LodBand ghosts stand in for the other
+    // levels' bodies near a boundary, so pairs across it are still collided.
+    for (const SimLod& lod : lods)
+    {
+        DeclareDetectEntitiesCollision(world, core.prePhysics, lod);
+        DeclareDetectGridEntityCollision(world, core.prePhysics, lod);
+        DeclareSolveContactsSystem(world, core.prePhysics, lod);
+        DeclareApplyCollisionResponseSystem(world, core.prePhysics, lod);
+        DeclareMoveEntitiesSystem(world, core.prePhysics, lod);
+    }
+}
+
+#ifdef PHYSICS_MODULE
+// Entry point of the MyProjectPhysics module, resolved with dlsym by hot_reload.cpp
+extern "C" void HotDeclarePhysicsSystems(flecs::world& world, const SimCore& core)
+{
+    DeclarePhysicsSystems(world, core);
+}
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <cmath>
+
+// --- Procedural meshes, CPU side only.
+// raylib's GenMesh* functions upload to the GPU before they return, so they need the GL thread.
+// These only fill the Mesh arrays (allocated with MemAlloc, so UnloadMesh frees them as usual)
+// and can run on any thread; UploadMesh() on the GL thread finishes the job.
+
+// Generated meshes are cached by generator version (mesh_cache.h): bump this with any change to
+// what GenSphereMeshData produces, or old cache files keep being used
+#define SPHERE_MESH_GENERATOR_VERSION 1
+
+// Indexed UV sphere: rings + 1 rows of slices + 1 vertices, seams and poles duplicated so every
+// vertex has its own texcoord. Counterclockwise front faces, like raylib's GenMeshSphere.
+inline Mesh GenSphereMeshData(float radius, int rings, int slices)
+{
+    Mesh mesh = { 0 };
+    if (rings < 2 || slices < 3 || (rings + 1) * (slices + 1) > 65536) // 16-bit indices
+        return mesh;
+
+    const int columns = slices + 1;
+    mesh.vertexCount = (rings + 1) * columns;
+    mesh.triangleCount = rings * slices * 2;
+    mesh.vertices = static_cast<float*>(MemAlloc(mesh.vertexCount * 3 * sizeof(float)));
+    mesh.normals = static_cast<float*>(MemAlloc(mesh.vertexCount * 3 * sizeof(float)));
+    mesh.texcoords = static_cast<float*>(MemAlloc(mesh.vertexCount * 2 * sizeof(float)));
+    mesh.indices = static_cast<unsigned short*>(MemAlloc(mesh.triangleCount * 3 * sizeof(unsigned short)));
+
+    for (int ring = 0; ring <= rings; ++ring)
+    {
+        const float theta = PI * static_cast<float>(ring) / rings; // from the +Y pole
+        for (int slice = 0; slice <= slices; ++slice)
+        {
+            const float phi = 2.0f * PI * static_cast<float>(slice) / slices;
+            const int v = ring * columns + slice;
+            const float n[3] = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+            for (int k = 0; k < 3; ++k)
+            {
+                mesh.normals[v * 3 + k] = n[k];
+                mesh.vertices[v * 3 + k] = n[k] * radius;
+            }
+            mesh.texcoords[v * 2 + 0] = static_cast<float>(slice) / slices;
+            mesh.texcoords[v * 2 + 1] = static_cast<float>(ring) / rings;
+        }
+    }
+
+    int i = 0;
+    for (int ring = 0; ring < rings; ++ring)
+    {
+        for (int slice = 0; slice < slices; ++slice)
+        {
+            const unsigned short a = static_cast<unsigned short>(ring * columns + slice);
+            const unsigned short b = static_cast<unsigned short>(a + columns); // next ring down
+            mesh.indices[i++] = a;
+            mesh.indices[i++] = static_cast<unsigned short>(a + 1);
+            mesh.indices[i++] = b;
+            mesh.indices[i++] = static_cast<unsigned short>(a + 1);
+            mesh.indices[i++] = static_cast<unsigned short>(b + 1);
+            mesh.indices[i++] = b;
+        }
+    }
+    return mesh;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// --- Per-frame reductions fused into existing passes.
+// A ReductionPass is attached to one multi-threaded loop that already walks the data (a Flecs
+// system or a job pool ParallelFor). Reducers are declared on it once; the loop hands every
+// chunk it processes to Accumulate() with its thread index, which folds the chunk into each
+// reducer's partial for that thread. Combine() merges the partials once all threads are done,
+// publishes the totals and clears the partials for the next frame. N statistics therefore
+// cost one pass over the data instead of N, and threads never share a cache line.
+template<typename Chunk>
+class ReductionPass
+{
+public:
+    // accumulate(Partial&, const Chunk&) folds one chunk, combine(Partial& total, const Partial&)
+    // merges one thread's partial. The returned totals stay valid for the life of the pass and
+    // are updated by every Combine().
+    template<typename Partial, typename AccumulateFn, typename CombineFn>
+    const Partial& Add(AccumulateFn accumulate, CombineFn combine)
+    {
+        auto reducer = std::make_unique<Reducer<Partial, AccumulateFn, CombineFn>>(std::move(accumulate), std::move(combine));
+        reducer->SetThreads(threadCount);
+        const Partial& total = reducer->total;
+        reducers.push_back(std::move(reducer));
+        return total;
+    }
+
+    // Thread indices passed to Accumulate must be in [0, threadCount)
+    void SetThreads(int newThreadCount)
+    {
+        threadCount = std::max(newThreadCount, 1);
+        for (auto& reducer : reducers)
+        {
+            reducer->SetThreads(threadCount);
+        }
+    }
+
+    void Accumulate(int threadIndex, const Chunk& chunk)
+    {
+        for (auto& reducer : reducers)
+        {
+            reducer->Accumulate(threadIndex, chunk);
+        }
+    }
+
+    // Single threaded, after the pass
+    void Combine()
+    {
+        for (auto& reducer : reducers)
+        {
+            reducer->Combine();
+        }
+    }
+
+private:
+    struct ReducerBase
+    {
+        virtual ~ReducerBase() = default;
+        virtual void SetThreads(int threadCount) = 0;
+        virtual void Accumulate(int threadIndex, const Chunk& chunk) = 0;
+        virtual void Combine() = 0;
+    };
+
+    template<typename Partial, typename AccumulateFn, typename CombineFn>
+    struct Reducer : ReducerBase
+    {
+        struct alignas(64) Slot
+        {
+            Partial value{};
+        };
+
+        Reducer(AccumulateFn accumulate, CombineFn combine)
+            : accumulate(std::move(accumulate))
+            , combine(std::move(combine))
+        {
+        }
+
+        void SetThreads(int threadCount) override
+        {
+            partials.assign(threadCount, Slot{});
+        }
+
+        void Accumulate(int threadIndex, const Chunk& chunk) override
+        {
+            accumulate(partials[threadIndex].value, chunk);
+        }
+
+        void Combine() override
+        {
+            Partial result{};
+            for (Slot& slot : partials)
+            {
+                combine(result, slot.value);
+                slot.value = Partial{};
+            }
+            total = result;
+        }
+
+        AccumulateFn accumulate;
+        CombineFn combine;
+        std::vector<Slot> partials;
+        Partial total{};
+    };
+
+    std::vector<std::unique_ptr<ReducerBase>> reducers;
+    int threadCount = 1;
+};
@@ -0,0 +1,321 @@
+#include "scenario.h"
+
+#include "cJSON.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+// --- Loading ---
+static float ReadNumber(const cJSON* object, const char* key, float fallback)
+{
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(object, key);
+    if (!item)
+        return fallback;
+    if (!cJSON_IsNumber(item))
+    {
+        SimLog(LOG_WARNING, "Scenario: '%s' is not a number, keeping %g", key, fallback);
+        return fallback;
+    }
+    return static_cast<float>(item->valuedouble);
+}
+
+static std::string ReadString(const cJSON* object, const char* key, const std::string& fallback)
+{
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(object, key);
+    if (!item)
+        return fallback;
+    if (!cJSON_IsString(item))
+    {
+        SimLog(LOG_WARNING, "Scenario: '%s' is not a string, keeping '%s'", key, fallback.c_str());
+        return fallback;
+    }
+    return item->valuestring;
+}
+
+static void WarnUnknownKeys(const cJSON* object, std::initializer_list<const char*> known)
+{
+    const cJSON* item = nullptr;
+    cJSON_ArrayForEach(item, object)
+    {
+        const bool found = std::any_of(known.begin(), known.end(), [&](const char* key) { return std::strcmp(key, item->string) == 0; });
+        if (!found)
+        {
+            SimLog(LOG_WARNING, "Scenario: unknown key '%s' ignored", item->string);
+        }
+    }
+}
+
+bool LoadScenario(const std::string& path, Scenario& scenario, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    cJSON* root = cJSON_Parse(text.str().c_str());
+    if (!root || !cJSON_IsObject(root))
+    {
+        const char* at = cJSON_GetErrorPtr();
+        error = path + ": invalid JSON" + (at ? std::string(" near '") + std::string(at).substr(0, 20) + "'" : std::string());
+        cJSON_Delete(root);
+        return false;
+    }
+
+    WarnUnknownKeys(root, { "name", "mode", "count", "frames", "seed", "arena", "gravity", "distribution", "radius", "speed" });
+
+    scenario.name = ReadString(root, "name", scenario.name);
+    const std::string mode = ReadString(root, "mode", scenario.mode == SimulationMode::Fluid ? "fluid" : "bounce");
+    if (mode == "fluid")
+        scenario.mode = SimulationMode::Fluid;
+    else if (mode == "bounce")
+        scenario.mode = SimulationMode::Bounce;
+    else
+        SimLog(LOG_WARNING, "Scenario: unknown mode '%s' ignored", mode.c_str());
+
+    scenario.count = std::max(static_cast<int>(ReadNumber(root, "count", static_cast<float>(scenario.count))), 0);
+    scenario.frames = std::max(static_cast<int>(ReadNumber(root, "frames", static_cast<float>(scenario.frames))), 0);
+    if (const cJSON* seed = cJSON_GetObjectItemCaseSensitive(root, "seed"); cJSON_IsNumber(seed))
+    {
+        scenario.seed = static_cast<uint32_t>(seed->valuedouble);
+    }
+    scenario.arena = std::max(ReadNumber(root, "arena", scenario.arena), 0.0f);
+    scenario.gravity = ReadNumber(root, "gravity", scenario.gravity);
+
+    if (const cJSON* distribution = cJSON_GetObjectItemCaseSensitive(root, "distribution"))
+    {
+        WarnUnknownKeys(distribution, { "kind", "clusters", "spread", "spacing" });
+        const std::string kind = ReadString(distribution, "kind", "uniform");
+        if (kind == "uniform")
+            scenario.distribution = ScenarioDistribution::Uniform;
+        else if (kind == "clustered")
+            scenario.distribution = ScenarioDistribution::Clustered;
+        else if (kind == "lattice")
+            scenario.distribution = ScenarioDistribution::Lattice;
+        else if (kind == "cell")
+            scenario.distribution = ScenarioDistribution::SingleCell;
+        else
+            SimLog(LOG_WARNING, "Scenario: unknown distribution '%s' ignored", kind.c_str());
+
+        scenario.clusters = std::max(static_cast<int>(ReadNumber(distribution, "clusters", static_cast<float>(scenario.clusters))), 1);
+        scenario.clusterSpread = std::max(ReadNumber(distribution, "spread", scenario.clusterSpread), 0.0f);
+        scenario.latticeSpacing = std::max(ReadNumber(distribution, "spacing", scenario.latticeSpacing), 0.0f);
+    }
+
+    if (const cJSON* radius = cJSON_GetObjectItemCaseSensitive(root, "radius"))
+    {
+        WarnUnknownKeys(radius, { "mean", "variation" });
+        scenario.radiusMean = std::max(ReadNumber(radius, "mean", scenario.radiusMean), 0.01f);
+        scenario.radiusVariation = std::clamp(ReadNumber(radius, "variation", scenario.radiusVariation), 0.0f, 0.99f);
+    }
+
+    if (const cJSON* speed = cJSON_GetObjectItemCaseSensitive(root, "speed"))
+    {
+        WarnUnknownKeys(speed, { "min", "max" });
+        scenario.speedMin = std::max(ReadNumber(speed, "min", scenario.speedMin), 0.0f);
+        scenario.speedMax = std::max(ReadNumber(speed, "max", scenario.speedMax), scenario.speedMin);
+    }
+
+    cJSON_Delete(root);
+    return true;
+}
+
+// --- Spawning ---
+// Placement draws from the scenario's own generator, never the shared one, so nothing else
+// drawing random numbers can shift a scene. Hand-rolled mappings instead of the
+// std::*_distribution classes, whose output differs between standard libraries.
+struct ScenarioRandom
+{
+    std::mt19937 engine;
+
+    explicit ScenarioRandom(uint32_t seed)
+        : engine(seed)
+    {
+    }
+
+    float Float(float min, float max)
+    {
+        return min + (max - min) * static_cast<float>(engine() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Box-Muller, one of the pair is dropped
+    float Gaussian()
+    {
+        const float u1 = Float(1e-6f, 1.0f);
+        const float u2 = Float(0.0f, 1.0f);
+        return std::sqrt(-2.0f * std::log(u1)) * std::cos(2.0f * PI * u2);
+    }
+};
+
+void SpawnScenario(flecs::world& world, const Scenario& scenario)
+{
+    ReleaseAllEntities(world);
+
+    GameState& game_state = world.ensure<GameState>();
+    game_state.entitySpeed = scenario.speedMax;
+    game_state.gravity = scenario.gravity;
+
+    if (scenario.mode == SimulationMode::Fluid)
+    {
+        world.modified<GameState>();
+        SpawnFluidScene(world, scenario.count);
+        if (scenario.arena > 0.0f)
+        {
+            world.ensure<GameState>().gridSize = scenario.arena;
+        }
+        SimLog(LOG_INFO, "Scenario '%s': %d fluid particles", scenario.name.c_str(), scenario.count);
+        return;
+    }
+
+    game_state.simulationMode = SimulationMode::Bounce;
+    game_state.entitySize = scenario.radiusMean;
+    game_state.maxEntityRadius = scenario.radiusMean;
+    game_state.radiusModel = scenario.radiusVariation > 0.0f ? RadiusModel::PerEntity : RadiusModel::Uniform;
+    game_state.radiusVariation = scenario.radiusVariation;
+
+    float arena = scenario.arena;
+    if (arena <= 0.0f)
+    {
+        // same ~10% coverage as SpawnBounceScene
+        const float r = scenario.radiusMean;
+        if (game_state.dimensions == 3)
+            arena = std::max(std::cbrt(scenario.count * 4.0f / 3.0f * PI * r * r * r * 10.0f) * 0.5f, 100.0f);
+        else
+            arena = std::max(std::sqrt(scenario.count * PI * r * r * 10.0f) * 0.5f, 100.0f);
+    }
+
+    const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(scenario.count))));
+    const float spacing = scenario.latticeSpacing > 0.0f ? scenario.latticeSpacing : scenario.radiusMean * 3.0f;
+    if (scenario.distribution == ScenarioDistribution::Lattice && side * spacing > 2.0f * arena)
+    {
+        SimLog(LOG_WARNING, "Scenario '%s': lattice does not fit the arena, growing it to %.0f", scenario.name.c_str(), side * spacing * 0.5f);
+        arena = side * spacing * 0.5f;
+    }
+    game_state.gridSize = arena;
+    world.modified<GameState>();
+    ApplySimulationMode(world);
+
+    const float maxRadius = scenario.radiusMean * (1.0f + scenario.radiusVariation);
+    const float extent = std::max(arena - maxRadius, 0.0f);
+    const float cellSize = std::max(maxRadius * 2.0f, 1.0f); // GetCellSize for these radii
+    ScenarioRandom random(scenario.seed);
+
+    // 3D scenes spread bodies through the arena cube, except the lattice, which stays one layer.
+    // Z is only drawn in 3D, so the 2D sequence of a seed is unchanged.
+    const bool depth = game_state.dimensions == 3;
+    const auto depthFloat = [&](float min, float max) { return depth ? random.Float(min, max) : 0.0f; };
+
+    std::vector<Vector3> centers(scenario.clusters);
+    for (Vector3& center : centers)
+    {
+        const float x = random.Float(-extent, extent) * 0.8f;
+        const float y = random.Float(-extent, extent) * 0.8f;
+        center = { x, y, depthFloat(-extent, extent) * 0.8f };
+    }
+
+    std::vector<Position> positions(scenario.count);
+    std::vector<Velocity> velocities(scenario.count);
+    std::vector<Radius> radii(scenario.count);
+    const float origin = -side * spacing * 0.5f + spacing * 0.5f;
+    const float sigma = scenario.clusterSpread * arena;
+    for (int i = 0; i < scenario.count; ++i)
+    {
+        Vector3 p = { 0, 0, 0 };
+        switch (scenario.distribution)
+        {
+        case ScenarioDistribution::Uniform:
+        {
+            const float x = random.Float(-extent, extent);
+            const float y = random.Float(-extent, extent);
+            p = { x, y, depthFloat(-extent, extent) };
+            break;
+        }
+        case ScenarioDistribution::Clustered:
+        {
+            const Vector3& center = centers[i % centers.size()];
+            const float x = center.x + random.Gaussian() * sigma;
+            const float y = center.y + random.Gaussian() * sigma;
+            p = { x, y, depth ? center.z + random.Gaussian() * sigma : 0.0f };
+            break;
+        }
+        case ScenarioDistribution::Lattice:
+            p = { origin + (i % side) * spacing, origin + (i / side) * spacing, 0.0f };
+            break;
+        case ScenarioDistribution::SingleCell:
+            // strictly inside [0, cellSize) so float rounding cannot spill into a neighbour
+        {
+            const float x = random.Float(0.0f, cellSize * 0.999f);
+            const float y = random.Float(0.0f, cellSize * 0.999f);
+            p = { x, y, depthFloat(0.0f, cellSize * 0.999f) };
+            break;
+        }
+        }
+        positions[i].value = { std::clamp(p.x, -extent, extent), std::clamp(p.y, -extent, extent), std::clamp(p.z, -extent, extent) };
+
+        const float dx = random.Float(-1.0f, 1.0f);
+        const float dy = random.Float(-1.0f, 1.0f);
+        const Vector3 dir = { dx, dy, depthFloat(-1.0f, 1.0f) };
+        velocities[i].value = Vector3Scale(Vector3Normalize(dir), random.Float(scenario.speedMin, scenario.speedMax));
+        radii[i].value = scenario.radiusMean * random.Float(1.0f - scenario.radiusVariation, 1.0f + scenario.radiusVariation);
+    }
+    BulkSpawnEntities(world, positions, velocities, radii);
+
+    SimLog(LOG_INFO, "Scenario '%s': %d bodies in a %.0f arena", scenario.name.c_str(), scenario.count, arena);
+}
+
+// --- Broadphase stress patterns ---
+bool ParseStressPattern(const std::string& name, StressPattern& pattern)
+{
+    if (name == "cell")
+        pattern = StressPattern::SingleCell;
+    else if (name == "lattice")
+        pattern = StressPattern::TouchingLattice;
+    else if (name == "blob")
+        pattern = StressPattern::Blob;
+    else
+        return false;
+    return true;
+}
+
+Scenario MakeStressScenario(StressPattern pattern, int count, float radius)
+{
+    Scenario scenario;
+    scenario.mode = SimulationMode::Bounce;
+    scenario.count = count;
+    scenario.radiusMean = radius;
+    switch (pattern)
+    {
+    case StressPattern::SingleCell:
+        scenario.name = "stress_cell";
+        scenario.distribution = ScenarioDistribution::SingleCell;
+        break;
+    case StressPattern::TouchingLattice:
+        // at rest, so the lattice stays put and every frame tests the same touching pairs
+        scenario.name = "stress_lattice";
+        scenario.distribution = ScenarioDistribution::Lattice;
+        scenario.latticeSpacing = radius * 2.0f;
+        scenario.speedMin = 0.0f;
+        scenario.speedMax = 0.0f;
+        break;
+    case StressPattern::Blob:
+    {
+        // arena 20x the usual size; the blob is about as dense as a touching lattice
+        scenario.name = "stress_blob";
+        scenario.distribution = ScenarioDistribution::Clustered;
+        scenario.clusters = 1;
+        const float packed = std::sqrt(count * 4.0f * radius * radius);
+        scenario.arena = std::max(std::sqrt(count * PI * radius * radius * 10.0f) * 0.5f, 100.0f) * 20.0f;
+        scenario.clusterSpread = packed * 0.25f / scenario.arena;
+        break;
+    }
+    }
+    return scenario;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <cstdint>
+#include <string>
+
+// --- Benchmark scenarios ---
+// A scene described by a JSON file instead of code, so the reference scenes used for benchmarks
+// and regression comparisons live in scenarios/ and are versioned with the code.
+//
+// {
+//   "name": "bounce_clustered_50k",
+//   "mode": "bounce",                  // bounce | fluid
+//   "count": 50000,
+//   "frames": 600,                     // headless run length, 0 = --frames
+//   "seed": 1,                         // same seed, same positions and velocities
+//   "arena": 0,                        // gridSize (half extent), 0 = sized for ~10% coverage
+//   "gravity": 0,
+//   "distribution": { "kind": "clustered", "clusters": 16, "spread": 0.05 }, // uniform | clustered | lattice | cell
+//   "radius": { "mean": 4, "variation": 0.5 },
+//   "speed": { "min": 500, "max": 1500 }
+// }
+//
+// Every key is optional. A fluid scenario always starts as SpawnFluidScene's block at rest
+// density, only count, arena, gravity and the speed limit apply to it.
+
+enum class ScenarioDistribution : int
+{
+    Uniform = 0,    // anywhere in the arena, overlaps allowed
+    Clustered = 1,  // gaussian blobs around random centers
+    Lattice = 2,    // square grid centered in the arena
+    SingleCell = 3, // every body inside the broadphase cell at the origin
+};
+
+struct Scenario
+{
+    std::string name = "scenario";
+    SimulationMode mode = SimulationMode::Bounce;
+    int count = 1000;
+    int frames = 0;
+    uint32_t seed = 1;
+    float arena = 0.0f;
+    float gravity = 0.0f;
+
+    ScenarioDistribution distribution = ScenarioDistribution::Uniform;
+    int clusters = 8;          // Clustered: number of blobs
+    float clusterSpread = 0.05f; // Clustered: blob sigma as a fraction of the arena
+    float latticeSpacing = 0.0f; // Lattice: center distance, 0 = 3 mean radii
+
+    float radiusMean = 10.0f;
+    float radiusVariation = 0.0f; // > 0 switches to RadiusModel::PerEntity
+    float speedMin = 1500.0f;
+    float speedMax = 1500.0f;     // also the GameState speed limit
+};
+
+// False with a message in error when the file is missing or not valid JSON; unknown keys and
+// values are logged and skipped
+bool LoadScenario(const std::string& path, Scenario& scenario, std::string& error);
+
+// Releases the current entities, applies the scenario's GameState and bulk spawns its bodies.
+// Placement uses its own generator seeded with scenario.seed, so a scene is reproducible.
+void SpawnScenario(flecs::world& world, const Scenario& scenario);
+
+// --- Broadphase stress patterns ---
+// The layouts uniform placement never produces, for the worst cases of the broadphase and the
+// narrow phase. Built as scenarios, so they spawn and reproduce like any scenario file.
+enum class StressPattern : int
+{
+    SingleCell = 0,      // all bodies in one cell: every pair is a candidate
+    TouchingLattice = 1, // at rest on a lattice of exactly two radii: every neighbour touches
+    Blob = 2,            // one dense blob in a huge empty arena: sparse cells, one hot spot
+};
+
+// "cell", "lattice" or "blob"; false for anything else
+bool ParseStressPattern(const std::string& name, StressPattern& pattern);
+Scenario MakeStressScenario(StressPattern pattern, int count, float radius = 10.0f);
@@ -0,0 +1,1381 @@
+// the library's one instrumentation TU, ahead of any header that pulls instrumentation.h in
+#define INSTRUMENTATION_IMPLEMENTATION
+#include "instrumentation.h"
+#include "simulation.h"
+
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <format>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <span>
+#include <tuple>
+
+#include "simulation_internal.h"
+#include "fixed_point.h"
+#ifdef PHYSICS_HOT_RELOAD
+#include "hot_reload.h"
+#endif
+#include "job_pool.h"
+#include "reductions.h"
+
+
+// --- Logging ---
+static SimLogCallback g_simLogCallback = nullptr;
+
+void SetSimLogCallback(SimLogCallback callback)
+{
+    g_simLogCallback = callback;
+}
+
+void SimLog(int msgType, const char* text, ...)
+{
+    va_list args;
+    va_start(args, text);
+    if (g_simLogCallback)
+    {
+        g_simLogCallback(msgType, text, args);
+    }
+    else
+    {
+        fprintf(stderr, "%s ", GetLogMsgTypeAsString(msgType));
+        vfprintf(stderr, text, args);
+        fprintf(stderr, "\n");
+    }
+    va_end(args);
+}
+
+const char* GetLogMsgTypeAsString(int msgType)
+{
+    switch (msgType)
+    {
+        case LOG_INFO: return "[INFO]";
+        case LOG_ERROR: return "[ERROR]";
+        case LOG_WARNING: return "[WARN]";
+        case LOG_DEBUG: return "[DEBUG]";
+        default: return "";  break;
+    }
+    return "";
+}
+
+
+flecs::query<const GameState> get_game_state_query(const flecs::world& world)
+{
+	return world.query_builder<const GameState>()
+		.term_at(1)
+		//.singleton()
+		.cache_kind(flecs::QueryCacheAuto)
+		.build();
+}
+
+flecs::query<GameState> get_game_state_update_query(const flecs::world& world)
+{
+	return world.query_builder<GameState>()
+        .term_at(1)
+        //.singleton()
+        .build();
+}
+
+// --- Frame statistics ---
+// Reductions (reductions.h) fused into passes that run anyway: the body totals ride along with
+// UpdateSpatialCell, the contact count with the collision kernels and the bucket histogram with
+// the occupancy sampling. CombineFrameStats publishes the per-frame ones after PostPhysics work.
+struct BodyChunk
+{
+    const Position* positions;
+    const Velocity* velocities;
+    const Mass* masses; // nullptr when every body has unit mass
+    int count;
+};
+
+// Declares the statistics on a world's passes; the references are the totals Combine() publishes
+static FrameStats AddFrameStatReducers(ReductionPass<BodyChunk>& bodyPass, ReductionPass<int>& contactPass, ReductionPass<std::span<const int>>& cellPass)
+{
+    const int& bodies = bodyPass.Add<int>(
+        [](int& sum, const BodyChunk& chunk) { sum += chunk.count; },
+        [](int& total, const int& partial) { total += partial; });
+
+    const double& kineticEnergy = bodyPass.Add<double>(
+        [](double& sum, const BodyChunk& chunk)
+        {
+            for (int i = 0; i < chunk.count; ++i)
+            {
+                const float mass = chunk.masses ? chunk.masses[i].value : 1.0f;
+                sum += 0.5 * mass * Vector3LengthSqr(chunk.velocities[i].value);
+            }
+        },
+        [](double& total, const double& partial) { total += partial; });
+
+    const MomentumSum& momentum = bodyPass.Add<MomentumSum>(
+        [](MomentumSum& sum, const BodyChunk& chunk)
+        {
+            for (int i = 0; i < chunk.count; ++i)
+            {
+                const float mass = chunk.masses ? chunk.masses[i].value : 1.0f;
+                sum.x += mass * chunk.velocities[i].value.x;
+                sum.y += mass * chunk.velocities[i].value.y;
+                sum.z += mass * chunk.velocities[i].value.z;
+            }
+        },
+        [](MomentumSum& total, const MomentumSum& partial)
+        {
+            total.x += partial.x;
+            total.y += partial.y;
+            total.z += partial.z;
+        });
+
+    const float& maxSpeed = bodyPass.Add<float>(
+        [](float& maxSpeedSqr, const BodyChunk& chunk) // partials stay squared, the total is a speed
+        {
+            for (int i = 0; i < chunk.count; ++i)
+            {
+                maxSpeedSqr = std::max(maxSpeedSqr, Vector3LengthSqr(chunk.velocities[i].value));
+            }
+        },
+        [](float& total, const float& partial) { total = std::max(total, std::sqrt(partial)); });
+
+    const int& contacts = contactPass.Add<int>(
+        [](int& sum, const int& batch) { sum += batch; },
+        [](int& total, const int& partial) { total += partial; });
+
+    const OccupancyHistogram& occupancy = cellPass.Add<OccupancyHistogram>(
+        [](OccupancyHistogram& histogram, const std::span<const int>& cells)
+        {
+            for (int count : cells)
+            {
+                if (count == 0)
+                    continue;
+                ++histogram.occupiedCells;
+                histogram.maxPerCell = std::max(histogram.maxPerCell, count);
+                histogram.bodies += count;
+                int bin = 0;
+                while (bin < OCCUPANCY_BINS - 1 && count >= (2 << bin))
+                {
+                    ++bin;
+                }
+                ++histogram.bins[bin];
+            }
+        },
+        [](OccupancyHistogram& total, const OccupancyHistogram& partial)
+        {
+            total.occupiedCells += partial.occupiedCells;
+            total.maxPerCell = std::max(total.maxPerCell, partial.maxPerCell);
+            total.bodies += partial.bodies;
+            for (int bin = 0; bin < OCCUPANCY_BINS; ++bin)
+            {
+                total.bins[bin] += partial.bins[bin];
+            }
+        });
+
+    return { bodies, kineticEnergy, momentum, maxSpeed, contacts, occupancy };
+}
+
+// --- Helper Functions ---
+static std::mt19937& RandomGenerator()
+{
+    static std::mt19937 gen(std::random_device{}());
+    return gen;
+}
+
+float GetRandomFloat(float min, float max)
+{
+    std::uniform_real_distribution<float> dis(min, max);
+    return dis(RandomGenerator());
+}
+
+// Random spawn point and direction: through the arena cube in 3D scenes, on the Z = 0 plane
+// otherwise (no extra draws then, so 2D scenes keep their random sequence)
+static Vector3 RandomSpawnPoint(const GameState& game_state, float extent)
+{
+    const float x = GetRandomFloat(-extent, extent);
+    const float y = GetRandomFloat(-extent, extent);
+    return { x, y, game_state.dimensions == 3 ? GetRandomFloat(-extent, extent) : 0.0f };
+}
+
+static Vector3 RandomSpawnDirection(const GameState& game_state)
+{
+    const float x = GetRandomFloat(-1.0f, 1.0f);
+    const float y = GetRandomFloat(-1.0f, 1.0f);
+    return Vector3Normalize({ x, y, game_state.dimensions == 3 ? GetRandomFloat(-1.0f, 1.0f) : 0.0f });
+}
+
+// GetRandomFloat for worker threads, one generator per thread
+float GetThreadRandomFloat(float min, float max)
+{
+    thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_real_distribution<float> dis(min, max);
+    return dis(gen);
+}
+
+Color GetRandomColor()
+{
+    std::uniform_int_distribution<int> dis(50, 255);
+    return {
+        (unsigned char)dis(RandomGenerator()),
+        (unsigned char)dis(RandomGenerator()),
+        (unsigned char)dis(RandomGenerator()),
+        255
+    };
+}
+
+// --- Simulation LOD ---
+// Systems live in their module's scope; a module that was not imported has none to toggle
+static void EnableSystem(flecs::world& world, const std::string& path, bool enable)
+{
+    flecs::entity system = world.lookup(path.c_str());
+    if (system.is_valid())
+        system.enable(enable);
+}
+
+void ApplySimulationMode(flecs::world& world)
+{
+    const GameState& game_state = world.get<GameState>();
+    const bool fluid = game_state.simulationMode == SimulationMode::Fluid;
+    const bool impulse = !fluid && game_state.collisionSolver == CollisionSolver::SequentialImpulse;
+
+    for (int level = 0; level < 3; ++level)
+    {
+        const SimLod lod = { level, {} };
+        EnableSystem(world, "Physics::" + LodSystemName("DetectEntitiesCollision", lod), !fluid && !impulse);
+        EnableSystem(world, "Physics::" + LodSystemName("DetectGridEntity", lod), !impulse); // the impulse solver handles walls as contacts
+        EnableSystem(world, "Physics::" + LodSystemName("SolveContacts", lod), impulse);
+    }
+    EnableSystem(world, "SpatialIndex::BuildFluidGrid", fluid);
+    EnableSystem(world, "Physics::ComputeFluidDensity", fluid);
+    EnableSystem(world, "Physics::ApplyFluidForces", fluid);
+
+    GetBroadphase<BroadphaseKind::HashBuckets>(GetSimulationState(world)).buckets.clear();
+    SimLog(LOG_INFO, "Simulation mode: %s", fluid ? "Fluid" : (impulse ? "Bounce (impulse solver)" : "Bounce"));
+}
+
+// --- Entity pool ---
+// Despawned entities are parked instead of deleted: they keep their spawn component set, so
+// they stay in the same table, and only Position (plus FluidParticle on bodies) is toggled off.
+// Every simulation and render query goes through one of those two, so a parked entity is
+// invisible to them, and spawning/despawning is a bitset flip plus component writes instead
+// of a table move. Each spawn archetype has its own parked list.
+enum class SpawnArchetype : uint8_t
+{
+    Body = 0,  // full collision body: Position, Velocity, ColorComp, SpatialCell, CollisionResponse,
+               // FluidParticle, Mass, Restitution, Radius, Lifetime, SimClock
+    Spark = 1, // cosmetic entity: Position, Velocity, ColorComp, Radius, Lifetime, SimClock, Spark
+    Count
+};
+
+struct EntityPool
+{
+    std::vector<flecs::entity_t> parked[static_cast<int>(SpawnArchetype::Count)];
+};
+
+// The world's pool, in its SimulationInternals
+static EntityPool& GetEntityPool(const flecs::world& world);
+
+// Must run before any entity gets these components, toggling needs the bitset column
+static void RegisterPoolableComponents(flecs::world& world)
+{
+    world.component<Position>().add(flecs::CanToggle);
+    world.component<FluidParticle>().add(flecs::CanToggle);
+}
+
+// Writes the Lifetime and schedules it in the wheel; seconds <= 0 lives until removed
+void SetLifetime(flecs::entity e, float seconds)
+{
+    Lifetime& lifetime = e.ensure<Lifetime>();
+    lifetime.seconds = seconds;
+    lifetime.expiryTick = seconds > 0.0f ? GetSimulationState(e.world()).lifetimeWheel.Schedule(e.id(), seconds) : 0;
+}
+
+// A parked entity if there is one, otherwise a fresh entity with the archetype's component set.
+// The caller writes the components, nothing is added or removed afterwards.
+flecs::entity AcquireEntity(flecs::world& world, SpawnArchetype archetype = SpawnArchetype::Body)
+{
+    const bool body = archetype == SpawnArchetype::Body;
+    std::vector<flecs::entity_t>& parked = GetEntityPool(world).parked[static_cast<int>(archetype)];
+    while (!parked.empty())
+    {
+        flecs::entity e = flecs::entity(world, parked.back());
+        parked.pop_back();
+        if (!e.is_alive())
+            continue; // deleted behind the pool's back
+
+        e.enable<Position>();
+        if (body)
+            e.enable<FluidParticle>();
+        return e;
+    }
+
+    // only taken until the pool has warmed up: created straight into the archetype's table, one
+    // insert instead of a table move per component
+    ecs_bulk_desc_t desc = {};
+    int column = 0;
+    for (ecs_id_t id : { world.id<Position>(), world.id<Velocity>(), world.id<ColorComp>(), world.id<Radius>(), world.id<Lifetime>(), world.id<SimClock>() })
+    {
+        desc.ids[column++] = id;
+    }
+    if (body)
+    {
+        for (ecs_id_t id : { world.id<SpatialCell>(), world.id<CollisionResponse>(), world.id<FluidParticle>(), world.id<Mass>(), world.id<Restitution>() })
+        {
+            desc.ids[column++] = id;
+        }
+    }
+    else
+    {
+        desc.ids[column++] = world.id<Spark>();
+    }
+    desc.count = 1;
+    flecs::entity e(world, ecs_bulk_init(world.c_ptr(), &desc)[0]);
+
+    // bulk-appended rows do not promise an enabled toggle bit, see BulkSpawn
+    e.enable<Position>();
+    if (body)
+        e.enable<FluidParticle>();
+    return e;
+}
+
+void ReleaseEntity(flecs::entity e)
+{
+    const bool body = !e.has<Spark>();
+    e.disable<Position>();
+    e.set<Velocity>({ Vector3Zero() });
+    e.set<Lifetime>({}); // drops any pending expiry
+    if (body)
+    {
+        e.disable<FluidParticle>();
+        e.set<CollisionResponse>({ Vector3Zero(), Vector3Zero(), false });
+    }
+    GetEntityPool(e.world()).parked[static_cast<int>(body ? SpawnArchetype::Body : SpawnArchetype::Spark)].push_back(e.id());
+}
+
+// Parks every active entity
+void ReleaseAllEntities(flecs::world& world)
+{
+    std::vector<flecs::entity_t> active;
+    world.query<const Position>().each([&](flecs::entity e, const Position&)
+    {
+        active.push_back(e.id());
+    });
+
+    // toggled after iterating, the query holds the tables while it runs
+    for (flecs::entity_t id : active)
+    {
+        ReleaseEntity(flecs::entity(world, id));
+    }
+}
+
+// Deletes the parked entities, for when a churn burst is over
+void TrimEntityPool(flecs::world& world)
+{
+    world.defer_begin();
+    for (std::vector<flecs::entity_t>& parked : GetEntityPool(world).parked)
+    {
+        for (flecs::entity_t id : parked)
+        {
+            flecs::entity e(world, id);
+            if (e.is_alive())
+                e.destruct();
+        }
+        parked.clear();
+    }
+    world.defer_end();
+}
+
+int PooledEntityCount(const flecs::world& world)
+{
+    size_t count = 0;
+    for (const std::vector<flecs::entity_t>& parked : GetEntityPool(world).parked)
+    {
+        count += parked.size();
+    }
+    return static_cast<int>(count);
+}
+
+// --- Deferred spawn/despawn commands ---
+// Systems must not change table layouts while they iterate, and even deferred, every spawned
+// entity would be its own table move at the merge. Producers append plain requests to the
+// buffer of the thread they run on instead, and FlushCommandBuffers applies all of them at one
+// pipeline point: despawns go back to the pool, spawns are grouped by archetype and each group
+// refills parked entities and then creates the rest with a single bulk insert.
+struct SpawnRequest
+{
+    SpawnArchetype archetype = SpawnArchetype::Body;
+    Vector3 position = { 0, 0, 0 };
+    Vector3 velocity = { 0, 0, 0 };
+    Color color = WHITE;
+    float radius = 1.0f;
+    float lifetime = 0.0f;
+};
+
+struct CommandBuffer
+{
+    std::vector<SpawnRequest> spawns;
+    std::vector<flecs::entity_t> despawns;
+};
+
+// --- Per-world state ---
+// What SimulationState keeps away from the public header. One per world, like the state itself.
+struct SimulationInternals
+{
+    JobPool jobPool;
+    EntityPool entityPool;
+
+    // One buffer per worker. Index with the flecs stage id inside multi-threaded systems, or with
+    // the job pool thread index inside ParallelFor; the two never run at the same time.
+    std::vector<CommandBuffer> commandBuffers = std::vector<CommandBuffer>(1);
+    std::vector<SpawnRequest> flushGroups[static_cast<int>(SpawnArchetype::Count)]; // FlushCommandBuffers' staging
+
+    BroadphaseGrid<BroadphaseKind::SortedGrid> sortedGrid;
+    BroadphaseGrid<BroadphaseKind::HashBuckets> hashGrid;
+    FluidGrid fluidGrid;
+
+    // collision kernel work buffers, per precision
+    std::tuple<CollisionBodies<float>, CollisionBodies<double>, CollisionBodies<Fixed>> collisionBodies;
+    std::tuple<ContactSolver<float>, ContactSolver<double>, ContactSolver<Fixed>> contactSolvers;
+
+    // Frame statistics, see AddFrameStatReducers
+    ReductionPass<BodyChunk> bodyStatsPass;
+    ReductionPass<int> contactStatsPass;                      // contacts found by one batch
+    ReductionPass<std::span<const int>> cellStatsPass;        // bodies per cell, empty cells included
+    bool frameStatsEnabled = false;                           // set by the Stats module
+};
+
+SimulationState::SimulationState()
+    : internals(std::make_unique<SimulationInternals>())
+    , stats(AddFrameStatReducers(internals->bodyStatsPass, internals->contactStatsPass, internals->cellStatsPass))
+{
+}
+
+SimulationState::~SimulationState() = default;
+
+SimulationState& GetSimulationState(const flecs::world& world)
+{
+    return *world.get<SimulationWorld>().state;
+}
+
+static EntityPool& GetEntityPool(const flecs::world& world)
+{
+    return GetSimulationState(world).internals->entityPool;
+}
+
+template<BroadphaseKind Kind>
+BroadphaseGrid<Kind>& GetBroadphase(SimulationState& state)
+{
+    if constexpr (Kind == BroadphaseKind::SortedGrid)
+        return state.internals->sortedGrid;
+    else
+        return state.internals->hashGrid;
+}
+
+template BroadphaseGrid<BroadphaseKind::SortedGrid>& GetBroadphase<BroadphaseKind::SortedGrid>(SimulationState& state);
+template BroadphaseGrid<BroadphaseKind::HashBuckets>& GetBroadphase<BroadphaseKind::HashBuckets>(SimulationState& state);
+
+template<typename Real>
+CollisionBodies<Real>& GetCollisionBodies(SimulationState& state)
+{
+    return std::get<CollisionBodies<Real>>(state.internals->collisionBodies);
+}
+
+template<typename Real>
+ContactSolver<Real>& GetContactSolver(SimulationState& state)
+{
+    return std::get<ContactSolver<Real>>(state.internals->contactSolvers);
+}
+
+template CollisionBodies<float>& GetCollisionBodies<float>(SimulationState& state);
+template CollisionBodies<double>& GetCollisionBodies<double>(SimulationState& state);
+template CollisionBodies<Fixed>& GetCollisionBodies<Fixed>(SimulationState& state);
+template ContactSolver<float>& GetContactSolver<float>(SimulationState& state);
+template ContactSolver<double>& GetContactSolver<double>(SimulationState& state);
+template ContactSolver<Fixed>& GetContactSolver<Fixed>(SimulationState& state);
+
+FluidGrid& GetFluidGrid(SimulationState& state)
+{
+    return state.internals->fluidGrid;
+}
+
+JobPool& GetJobPool(SimulationState& state)
+{
+    return state.internals->jobPool;
+}
+
+ReductionPass<int>* GetContactStatsPass(SimulationState& state)
+{
+    return state.internals->frameStatsEnabled ? &state.internals->contactStatsPass : nullptr;
+}
+
+size_t CellBucketCount(const flecs::world& world)
+{
+    return GetSimulationState(world).internals->hashGrid.buckets.bucket_count();
+}
+
+CommandBuffer& GetCommandBuffer(SimulationState& state, int threadIndex)
+{
+    return state.internals->commandBuffers[threadIndex];
+}
+
+// Writes a spawn request's components into an acquired entity
+static void WriteSpawn(flecs::entity e, const SpawnRequest& request, const GameState& game_state)
+{
+    e.set<Position>({ request.position })
+        .set<Velocity>({ request.velocity })
+        .set<ColorComp>({ request.color })
+        .set<Radius>({ request.radius })
+        .set<SimClock>({ e.world().get<SimTime>().seconds });
+    if (request.archetype == SpawnArchetype::Body)
+    {
+        e.set<SpatialCell>({ 0, 0, 0 })
+            .set<CollisionResponse>({ Vector3Zero(), Vector3Zero(), false })
+            .set<FluidParticle>({})
+            .set<Mass>({ BodyMass(game_state, request.radius) })
+            .set<Restitution>({});
+    }
+    SetLifetime(e, request.lifetime);
+}
+
+// Spawns requests[0, count), all of one archetype: parked entities first, then one table insert
+void BulkSpawn(flecs::world& world, SpawnArchetype archetype, const SpawnRequest* requests, int count)
+{
+    GameState& game_state = world.ensure<GameState>();
+    const bool body = archetype == SpawnArchetype::Body;
+    if (body)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            game_state.maxEntityRadius = std::max(game_state.maxEntityRadius, requests[i].radius);
+        }
+    }
+
+    // refill parked entities first, only the remainder creates new ones
+    int reused = 0;
+    const std::vector<flecs::entity_t>& parked = GetEntityPool(world).parked[static_cast<int>(archetype)];
+    while (reused < count && !parked.empty())
+    {
+        WriteSpawn(AcquireEntity(world, archetype), requests[reused], game_state);
+        ++reused;
+    }
+
+    const int remaining = count - reused;
+    if (remaining == 0)
+        return;
+    requests += reused;
+
+    std::vector<Position> positions(remaining);
+    std::vector<Velocity> velocities(remaining);
+    std::vector<ColorComp> colors(remaining);
+    std::vector<Radius> radii(remaining);
+    std::vector<Lifetime> lifetimes(remaining); // scheduled after the insert, the wheel wants the ids
+    std::vector<SimClock> clocks(remaining, SimClock{ world.get<SimTime>().seconds });
+    for (int i = 0; i < remaining; ++i)
+    {
+        positions[i].value = requests[i].position;
+        velocities[i].value = requests[i].velocity;
+        colors[i].value = requests[i].color;
+        radii[i].value = requests[i].radius;
+    }
+
+    std::vector<SpatialCell> cells;
+    std::vector<CollisionResponse> responses;
+    std::vector<FluidParticle> fluid;
+    std::vector<Mass> masses;
+    std::vector<Restitution> restitutions;
+
+    ecs_bulk_desc_t desc = {};
+    void* data[FLECS_ID_DESC_MAX] = {};
+    int columns = 0;
+    const auto addColumn = [&](ecs_id_t id, void* values)
+    {
+        desc.ids[columns] = id;
+        data[columns] = values;
+        ++columns;
+    };
+    addColumn(world.id<Position>(), positions.data());
+    addColumn(world.id<Velocity>(), velocities.data());
+    addColumn(world.id<ColorComp>(), colors.data());
+    addColumn(world.id<Radius>(), radii.data());
+    addColumn(world.id<Lifetime>(), lifetimes.data());
+    addColumn(world.id<SimClock>(), clocks.data());
+    if (body)
+    {
+        cells.assign(remaining, SpatialCell{ 0, 0, 0 });
+        responses.resize(remaining);
+        fluid.resize(remaining);
+        masses.resize(remaining);
+        for (int i = 0; i < remaining; ++i)
+        {
+            masses[i].value = BodyMass(game_state, radii[i].value);
+        }
+        restitutions.resize(remaining);
+
+        addColumn(world.id<SpatialCell>(), cells.data());
+        addColumn(world.id<CollisionResponse>(), responses.data());
+        addColumn(world.id<FluidParticle>(), fluid.data());
+        addColumn(world.id<Mass>(), masses.data());
+        addColumn(world.id<Restitution>(), restitutions.data());
+    }
+    else
+    {
+        addColumn(world.id<Spark>(), nullptr); // tag, no data
+    }
+
+    desc.count = remaining;
+    desc.data = data;
+    const ecs_entity_t* ids = ecs_bulk_init(world.c_ptr(), &desc);
+
+    for (int i = 0; i < remaining; ++i)
+    {
+        // bulk-appended rows do not promise an enabled toggle bit
+        ecs_enable_id(world.c_ptr(), ids[i], world.id<Position>(), true);
+        if (body)
+            ecs_enable_id(world.c_ptr(), ids[i], world.id<FluidParticle>(), true);
+
+        if (requests[i].lifetime > 0.0f)
+            SetLifetime(flecs::entity(world, ids[i]), requests[i].lifetime);
+    }
+}
+
+// Applies and clears every thread's buffer. Must run outside of deferred mode (see the
+// immediate FlushCommandBuffers system), the bulk inserts are not deferrable.
+void FlushCommandBuffers(flecs::world& world)
+{
+    SimulationInternals& internals = *GetSimulationState(world).internals;
+    std::vector<SpawnRequest>* grouped = internals.flushGroups;
+
+    for (CommandBuffer& buffer : internals.commandBuffers)
+    {
+        for (flecs::entity_t id : buffer.despawns)
+        {
+            flecs::entity e(world, id);
+            if (e.is_alive() && e.enabled<Position>()) // several threads may despawn the same entity
+                ReleaseEntity(e);
+        }
+        for (const SpawnRequest& request : buffer.spawns)
+        {
+            grouped[static_cast<int>(request.archetype)].push_back(request);
+        }
+        buffer.despawns.clear();
+        buffer.spawns.clear();
+    }
+
+    for (int archetype = 0; archetype < static_cast<int>(SpawnArchetype::Count); ++archetype)
+    {
+        std::vector<SpawnRequest>& requests = grouped[archetype];
+        if (!requests.empty())
+        {
+            BulkSpawn(world, static_cast<SpawnArchetype>(archetype), requests.data(), static_cast<int>(requests.size()));
+            requests.clear();
+        }
+    }
+}
+
+static uint32_t PackColor(Color c)
+{
+    return uint32_t(c.r) | (uint32_t(c.g) << 8) | (uint32_t(c.b) << 16) | (uint32_t(c.a) << 24);
+}
+
+// Queues a burst of sparks at a contact point, as Spark entities or as cosmetic particles
+// depending on GameState::collisionEffect. Safe on any worker, it only touches the thread's
+// own staging data.
+void EmitCollisionEffect(SimulationState& state, int threadIndex, const GameState& game_state, const Vector3& at)
+{
+    for (int k = 0; k < game_state.sparksPerContact; ++k)
+    {
+        // a direction on the circle, or uniformly on the sphere in 3D
+        const float angle = GetThreadRandomFloat(0.0f, 2.0f * PI);
+        const float z = game_state.dimensions == 3 ? GetThreadRandomFloat(-1.0f, 1.0f) : 0.0f;
+        const float planar = std::sqrt(1.0f - z * z);
+        const float speed = game_state.entitySpeed * GetThreadRandomFloat(0.1f, 0.4f);
+        const Vector3 velocity = { std::cos(angle) * planar * speed, std::sin(angle) * planar * speed, z * speed };
+        const Color color = { 255, static_cast<unsigned char>(GetThreadRandomFloat(120.0f, 220.0f)), 40, 255 };
+        const float lifetime = GetThreadRandomFloat(0.15f, 0.5f);
+
+        if (game_state.collisionEffect == CollisionEffect::Particles)
+        {
+            state.particles.Emit(threadIndex, { at.x, at.y, at.z, velocity.x, velocity.y, velocity.z, lifetime, game_state.entitySize, PackColor(color) });
+            continue;
+        }
+
+        SpawnRequest request;
+        request.archetype = SpawnArchetype::Spark;
+        request.position = at;
+        request.velocity = velocity;
+        request.color = color;
+        request.radius = game_state.entitySize * 0.25f;
+        request.lifetime = lifetime;
+        GetCommandBuffer(state, threadIndex).spawns.push_back(request);
+    }
+}
+
+// --- Entity Management Function ---
+// Writes the full spawn component set into a pooled or fresh entity
+flecs::entity SpawnEntity(flecs::world& world, const Vector3& position, const Vector3& velocity, float radius, float lifetimeSeconds)
+{
+    GameState& game_state = world.ensure<GameState>();
+
+    SpawnRequest request;
+    request.position = position;
+    request.velocity = velocity;
+    request.color = GetRandomColor();
+    request.radius = radius;
+    request.lifetime = lifetimeSeconds;
+
+    flecs::entity new_entity = AcquireEntity(world);
+    WriteSpawn(new_entity, request, game_state);
+
+    game_state.maxEntityRadius = std::max(game_state.maxEntityRadius, radius);
+    return new_entity;
+}
+
+void CreateEntity(flecs::world& world)
+{
+    Vector3 newPos;
+    bool positionIsValid;
+    int maxRetries = 100;
+    int retries = 0;
+
+    GameState& game_state = world.ensure<GameState>();
+
+    float radius = game_state.entitySize;
+    if (game_state.radiusModel == RadiusModel::PerEntity)
+    {
+        radius *= GetRandomFloat(1.0f - game_state.radiusVariation, 1.0f + game_state.radiusVariation);
+    }
+
+    // sparks are cosmetic and short-lived, a body may spawn on top of one
+    flecs::query<const Position, const Radius> bodies = world.query_builder<const Position, const Radius>()
+        .without<Spark>()
+        .build();
+
+    do
+    {
+        positionIsValid = true;
+        newPos = RandomSpawnPoint(game_state, game_state.gridSize - radius);
+        bodies.each([&](const Position& existing_pos, const Radius& existing_radius)
+            {
+                const float existingRadius = game_state.radiusModel == RadiusModel::PerEntity ? existing_radius.value : game_state.entitySize;
+                if (Vector3Distance(newPos, existing_pos.value) < radius + existingRadius)
+                {
+                    positionIsValid = false;
+                }
+            });
+        retries++;
+    } while (!positionIsValid && retries < maxRetries);
+
+    if (!positionIsValid)
+    {
+        SimLog(LOG_WARNING, "Failed to find a valid position for new entity after %d retries.", maxRetries);
+        return; // Failed to find a spot
+    }
+
+    auto new_entity = SpawnEntity(world, newPos, Vector3Scale(RandomSpawnDirection(game_state), game_state.entitySpeed), radius, game_state.spawnLifetime);
+
+    SimLog(LOG_INFO, "Created entity %s", new_entity.name().c_str());
+}
+
+// Creates count entities with the full component set in a single table insert, instead of
+// CreateEntity's per-component table moves and O(n) overlap search. Used for large scenes.
+void BulkSpawnEntities(flecs::world& world, std::vector<Position>& positions, std::vector<Velocity>& velocities, const std::vector<Radius>& radii)
+{
+    const GameState& game_state = world.get<GameState>();
+
+    std::vector<SpawnRequest> requests(positions.size());
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        requests[i].position = positions[i].value;
+        requests[i].velocity = velocities[i].value;
+        requests[i].color = GetRandomColor();
+        requests[i].radius = radii.empty() ? game_state.entitySize : radii[i].value;
+    }
+
+    const int pooled = static_cast<int>(GetEntityPool(world).parked[static_cast<int>(SpawnArchetype::Body)].size());
+    BulkSpawn(world, SpawnArchetype::Body, requests.data(), static_cast<int>(requests.size()));
+    SimLog(LOG_INFO, "Bulk spawned %d entities (%d from the pool)", static_cast<int>(requests.size()), std::min(pooled, static_cast<int>(requests.size())));
+}
+
+// Uniform random placement without overlap checks, sized so the arena (a cube in 3D) is ~10% covered
+void SpawnBounceScene(flecs::world& world, int count)
+{
+    GameState& game_state = world.ensure<GameState>();
+    game_state.simulationMode = SimulationMode::Bounce;
+    const float r = game_state.entitySize;
+    if (game_state.dimensions == 3)
+        game_state.gridSize = std::max(std::cbrt(count * 4.0f / 3.0f * PI * r * r * r * 10.0f) * 0.5f, 100.0f);
+    else
+        game_state.gridSize = std::max(std::sqrt(count * PI * r * r * 10.0f) * 0.5f, 100.0f);
+    world.modified<GameState>();
+    ApplySimulationMode(world);
+
+    std::vector<Position> positions(count);
+    std::vector<Velocity> velocities(count);
+    const float extent = game_state.gridSize - game_state.entitySize;
+    for (int i = 0; i < count; ++i)
+    {
+        positions[i].value = RandomSpawnPoint(game_state, extent);
+        velocities[i].value = Vector3Scale(RandomSpawnDirection(game_state), game_state.entitySpeed);
+    }
+    BulkSpawnEntities(world, positions, velocities);
+}
+
+// Square block of fluid on a lattice at half the smoothing radius. The rest density is
+// derived from that lattice so the block starts close to equilibrium.
+void SpawnFluidScene(flecs::world& world, int count)
+{
+    GameState& game_state = world.ensure<GameState>();
+    game_state.simulationMode = SimulationMode::Fluid;
+
+    const float h = game_state.fluidSmoothingRadius;
+    const float spacing = h * 0.5f;
+    const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    const float blockSize = side * spacing;
+
+    game_state.entitySize = spacing * 0.5f;
+    game_state.gridSize = blockSize * 0.5f / 0.8f;
+
+    const FluidKernel kernel(h);
+    float sum = 0.0f;
+    const int reach = static_cast<int>(std::ceil(h / spacing));
+    for (int j = -reach; j <= reach; ++j)
+    {
+        for (int i = -reach; i <= reach; ++i)
+        {
+            const float r2 = (i * i + j * j) * spacing * spacing;
+            if (r2 < kernel.h2)
+            {
+                const float d = kernel.h2 - r2;
+                sum += d * d * d;
+            }
+        }
+    }
+    game_state.fluidRestDensity = game_state.fluidParticleMass * kernel.poly6 * sum;
+    ApplySimulationMode(world);
+
+    std::vector<Position> positions(count);
+    std::vector<Velocity> velocities(count);
+    const float origin = -blockSize * 0.5f + spacing * 0.5f;
+    for (int i = 0; i < count; ++i)
+    {
+        const float jitter = spacing * 0.05f;
+        positions[i].value = {
+            origin + (i % side) * spacing + GetRandomFloat(-jitter, jitter),
+            origin + (i / side) * spacing + GetRandomFloat(-jitter, jitter),
+            0.0f
+        };
+        const Vector3 dir = { GetRandomFloat(-1.0f, 1.0f), GetRandomFloat(-1.0f, 1.0f), 0.0f };
+        velocities[i].value = Vector3Scale(Vector3Normalize(dir), game_state.entitySpeed * 0.25f);
+    }
+    BulkSpawnEntities(world, positions, velocities);
+}
+
+// Each churn spawn goes through SpawnEntity like CreateEntity does (minus the overlap search),
+// so the live set turns over every few frames and the pool and the lifetime wheel carry all of
+// the churn
+ChurnScene SetupChurnScene(flecs::world& world, int count, int frames)
+{
+    GameState& game_state = world.ensure<GameState>();
+    game_state.simulationMode = SimulationMode::Bounce;
+    game_state.gridSize = 1000.0f;
+    world.modified<GameState>();
+    ApplySimulationMode(world);
+
+    ChurnScene scene;
+    scene.total = count;
+    scene.perFrame = (count + frames - 1) / std::max(frames, 1);
+    return scene;
+}
+
+void SpawnChurnWave(flecs::world& world, ChurnScene& scene)
+{
+    const GameState& game_state = world.get<GameState>();
+    const float extent = game_state.gridSize - game_state.entitySize;
+    const int count = static_cast<int>(std::min<long long>(scene.perFrame, scene.total - scene.spawned));
+    for (int i = 0; i < count; ++i)
+    {
+        const Vector3 position = RandomSpawnPoint(game_state, extent);
+        SpawnEntity(world, position, Vector3Scale(RandomSpawnDirection(game_state), game_state.entitySpeed), game_state.entitySize, GetRandomFloat(0.05f, 0.5f));
+    }
+    scene.spawned += count;
+}
+
+
+void DeclareGameStateObserver(flecs::world& world)
+{
+    world.observer<GameState>()
+        //.kind<StateObserverSystem>()
+        .event(flecs::OnSet)
+        .each([&](flecs::entity e, GameState& gs)
+        {
+            // update velocity
+
+            //std::cout << "Position set: {" << p.x << ", " << p.y << "}\n";
+				// sparks keep the speed of their burst
+				world.query_builder<Velocity>().without<Spark>().build().each([&](flecs::entity e, Velocity& v)
+				{
+                    v = { Vector3Scale(Vector3Normalize(v.value), gs.entitySpeed) };
+				});
+        });
+}
+
+// Sets this frame's periodic tick sources. Declared first in the first phase, so every system
+// on a periodic source sees the current frame's tick.
+void DeclareAdvancePeriodicJobsSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("AdvancePeriodicJobs")
+        .kind(inPhase)
+        .each([&]()
+        {
+            GetSimulationState(world).periodicJobs.Advance(world.delta_time());
+        });
+}
+
+// Refreshes the entity counts shown in the GUI
+void DeclareSampleSceneCountsSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("SampleSceneCounts")
+        .kind(inPhase)
+        .tick_source(GetSimulationState(world).periodicJobs.Every(world, "SceneCountsTick", 0.25f))
+        .each([&]()
+        {
+            SceneCounts& counts = GetSimulationState(world).sceneCounts;
+            const int parkedSparks = static_cast<int>(GetEntityPool(world).parked[static_cast<int>(SpawnArchetype::Spark)].size());
+            counts.pooled = PooledEntityCount(world);
+            counts.sparks = world.count<Spark>() - parkedSparks;
+            counts.entities = world.count<Position>() - counts.pooled - counts.sparks; // bodies only
+            counts.lodMid = world.count<LodMid>();
+            counts.lodFar = world.count<LodFar>();
+        });
+}
+
+// Applies the spawn/despawn requests queued by this frame's systems. Immediate, so the world is
+// not deferred while it runs and the bulk inserts happen right here.
+void DeclareFlushCommandBuffersSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("FlushCommandBuffers")
+        .kind(inPhase)
+        .immediate()
+        .each([&]()
+        {
+            FlushCommandBuffers(world);
+        });
+}
+
+// --- Cosmetic particles ---
+// One trail particle per moving body and frame, written into the stage's staging list
+void DeclareEmitTrailsSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<const Position, const Velocity>("EmitTrails")
+        .multi_threaded()
+        .kind(inPhase)
+        .without<Spark>()
+        .run([&](flecs::iter& it)
+        {
+            const GameState& game_state = world.get<GameState>();
+            if (!game_state.particleTrails)
+            {
+                it.fini();
+                return;
+            }
+
+            ParticleSystem& particles = GetSimulationState(world).particles;
+            const int threadIndex = it.world().get_stage_id();
+            while (it.next())
+            {
+                auto p = it.field<const Position>(0);
+                auto v = it.field<const Velocity>(1);
+                for (auto i : it)
+                {
+                    const Vector3 drift = Vector3Scale(v[i].value, -0.1f);
+                    particles.Emit(threadIndex, { p[i].value.x, p[i].value.y, p[i].value.z, drift.x, drift.y, drift.z, 0.3f, game_state.entitySize * 0.5f, PackColor(SKYBLUE) });
+                }
+            }
+        });
+}
+
+// Integrates the world's particles on its job pool; no component is read or written
+void DeclareUpdateParticlesSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("UpdateParticles")
+        .kind(inPhase)
+        .each([&]()
+        {
+            const GameState& game_state = world.get<GameState>();
+            const float clampedDeltaTime = std::min(world.delta_time(), 0.33f);
+            SimulationState& state = GetSimulationState(world);
+            state.particles.Update(clampedDeltaTime, game_state.gravity, game_state.particleDrag, GetJobPool(state));
+        });
+}
+
+// --- Lifetimes ---
+// Advances the wheel and queues whatever expired as despawns. Only the due wheel slots are
+// visited; FlushCommandBuffers, right after, parks them before it applies the frame's spawns,
+// so those can reuse the freed entities at once.
+void DeclareExpireLifetimesSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("ExpireLifetimes")
+        .kind(inPhase)
+        .each([&]()
+        {
+            SimulationState& state = GetSimulationState(world);
+            std::vector<flecs::entity_t>& expired = GetCommandBuffer(state, 0).despawns; // single-threaded system, main stage
+
+            const float clampedDeltaTime = std::min(world.delta_time(), 0.33f);
+            state.lifetimeWheel.Advance(clampedDeltaTime, [&](uint64_t id, uint64_t tick)
+            {
+                flecs::entity e(world, id);
+                if (!e.is_alive())
+                    return;
+
+                const Lifetime* lifetime = e.try_get<Lifetime>();
+                if (lifetime && lifetime->expiryTick == tick)
+                {
+                    expired.push_back(id);
+                }
+            });
+        });
+}
+
+// Update spatial cell for each entity. Pure per-entity work: the broadphase structures are
+// built from SpatialCell by the collision systems, so this runs on all workers.
+// Also feeds the body statistics pass, the only full pass over the bodies that runs every frame
+void DeclareUpdateSpatialCellSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<const Position, SpatialCell, const Velocity, const Mass>("UpdateSpatialCell")
+        .multi_threaded()
+        .kind(inPhase)
+        .read<Position>()
+        .write<SpatialCell>()
+        .run([&](flecs::iter& it)
+        {
+            const GameState& game_state = world.get<GameState>();
+            const float cellSize = GetCellSize(game_state);
+            const bool perEntityMass = game_state.radiusModel == RadiusModel::PerEntity;
+            const bool depth = game_state.dimensions == 3 && game_state.simulationMode != SimulationMode::Fluid;
+            const int threadIndex = it.world().get_stage_id();
+            SimulationInternals& internals = *GetSimulationState(world).internals;
+            while (it.next())
+            {
+                auto p = it.field<const Position>(0);
+                auto sc = it.field<SpatialCell>(1);
+                auto v = it.field<const Velocity>(2);
+                auto m = it.field<const Mass>(3);
+                const int count = static_cast<int>(it.count());
+                for (int i = 0; i < count; ++i)
+                {
+                    sc[i] = ComputeCell(p[i].value, cellSize, depth);
+                }
+
+                if (internals.frameStatsEnabled)
+                    internals.bodyStatsPass.Accumulate(threadIndex, { &p[0], &v[0], perEntityMass ? &m[0] : nullptr, count });
+            }
+        });
+}
+
+// Publishes the frame's fused statistics once every pass feeding them is done
+void DeclareCombineFrameStatsSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("CombineFrameStats")
+        .kind(inPhase)
+        .each([&]()
+        {
+            SimulationInternals& internals = *GetSimulationState(world).internals;
+            internals.bodyStatsPass.Combine();
+            internals.contactStatsPass.Combine();
+        });
+}
+
+// Bucket histogram of whichever broadphase was built last. Reads the buckets in place on the
+// job pool, nothing is rebuilt for it.
+void DeclareSampleBroadphaseOccupancySystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<>("SampleBroadphaseOccupancy")
+        .kind(inPhase)
+        .tick_source(GetSimulationState(world).periodicJobs.Every(world, "BroadphaseOccupancyTick", 0.5f))
+        .each([&]()
+        {
+            const GameState& game_state = world.get<GameState>();
+            SimulationState& state = GetSimulationState(world);
+            ReductionPass<std::span<const int>>& cellStatsPass = state.internals->cellStatsPass;
+            if (game_state.broadphase == BroadphaseKind::SortedGrid)
+            {
+                const std::vector<int>& cellStart = GetBroadphase<BroadphaseKind::SortedGrid>(state).cells.cellStart;
+                GetJobPool(state).ParallelFor(static_cast<int>(cellStart.size()) - 1, 4096, [&](int begin, int end, int threadIndex)
+                {
+                    thread_local std::vector<int> counts;
+                    counts.resize(end - begin);
+                    for (int c = begin; c < end; ++c)
+                    {
+                        counts[c - begin] = cellStart[c + 1] - cellStart[c];
+                    }
+                    cellStatsPass.Accumulate(threadIndex, counts);
+                });
+            }
+            else
+            {
+                // the map's own hash buckets split it into independent, read-only ranges
+                const std::unordered_map<long long, std::vector<int>>& buckets = GetBroadphase<BroadphaseKind::HashBuckets>(state).buckets;
+                GetJobPool(state).ParallelFor(static_cast<int>(buckets.bucket_count()), 256, [&](int begin, int end, int threadIndex)
+                {
+                    thread_local std::vector<int> counts;
+                    counts.clear();
+                    for (int b = begin; b < end; ++b)
+                    {
+                        for (auto it = buckets.begin(b); it != buckets.end(b); ++it)
+                        {
+                            counts.push_back(static_cast<int>(it->second.size()));
+                        }
+                    }
+                    cellStatsPass.Accumulate(threadIndex, counts);
+                });
+            }
+            cellStatsPass.Combine();
+        });
+}
+
+// --- SPH fluid ---
+// Gathers Position/Velocity of every fluid particle into the world's FluidGrid, counting-sorted by the
+// cell UpdateSpatialCell assigned. Single-threaded: it is a linear pass feeding the two
+// multi-threaded passes below.
+void DeclareBuildFluidGridSystem(flecs::world& world, const flecs::entity& inPhase)
+{
+    world.system<const Position, const Velocity, const SpatialCell, FluidParticle>("BuildFluidGrid")
+        .kind(inPhase)
+        .run([&](flecs::iter& it)
+        {
+            const GameState& game_state = world.get<GameState>();
+            FluidGrid& grid = GetFluidGrid(GetSimulationState(world));
+
+            grid.cells.Reset(game_state.gridSize, GetCellSize(game_state));
+            grid.gatherPosX.clear();
+            grid.gatherPosY.clear();
+            grid.gatherVelX.clear();
+            grid.gatherVelY.clear();
+            grid.gatherCellX.clear();
+            grid.gatherCellY.clear();
+            grid.gatherParticle.clear();
+            grid.gatherId.clear();
+
+            while (it.next())
+            {
+                auto p = it.field<const Position>(0);
+                auto v = it.field<const Velocity>(1);
+                auto sc = it.field<const SpatialCell>(2);
+                auto fp = it.field<FluidParticle>(3);
+
+                for (auto i : it)
+                {
+                    grid.gatherPosX.push_back(p[i].value.x);
+                    grid.gatherPosY.push_back(p[i].value.y);
+                    grid.gatherVelX.push_back(v[i].value.x);
+                    grid.gatherVelY.push_back(v[i].value.y);
+                    grid.gatherCellX.push_back(sc[i].cellX);
+                    grid.gatherCellY.push_back(sc[i].cellY);
+                    grid.gatherParticle.push_back(&fp[i]);
+                    if (game_state.deterministic)
+                        grid.gatherId.push_back(it.entity(i).id());
+                }
+            }
+
+            // particles enter their cell in gather order, or in id order when deterministic so
+            // the neighbour sums do not depend on table order
+            grid.addOrder.resize(grid.gatherPosX.size());
+            std::iota(grid.addOrder.begin(), grid.addOrder.end(), 0);
+            if (game_state.deterministic)
+            {
+                std::sort(grid.addOrder.begin(), grid.addOrder.end(), [&](int a, int b) { return grid.gatherId[a] < grid.gatherId[b]; });
+            }
+            for (int g : grid.addOrder)
+            {
+                grid.gatherParticle[g]->gridIndex = grid.cells.Add(grid.gatherCellX[g], grid.gatherCellY[g]);
+            }
+
+            grid.cells.Sort();
+
+            const size_t count = grid.cells.itemAt.size();
+            grid.posX.resize(count);
+            grid.posY.resize(count);
+            grid.velX.resize(count);
+            grid.velY.resize(count);
+            grid.density.assign(count, 0.0f);
+            grid.pressure.assign(count, 0.0f);
+            for (size_t slot = 0; slot < count; ++slot)
+            {
+                const int g = grid.addOrder[grid.cells.itemAt[slot]];
+                grid.posX[slot] = grid.gatherPosX[g];
+                grid.posY[slot] = grid.gatherPosY[g];
+                grid.velX[slot] = grid.gatherVelX[g];
+                grid.velY[slot] = grid.gatherVelY[g];
+            }
+        });
+}
+
+ void OnFlecsLogCallback(int level, const char* file, int32_t line, const char* msg)
+ {
+	// Example: print only warnings and errors
+	if (level >= 1)
+	{
+		fprintf(stderr, "Flecs Log [Level %d]: %s\n", level, msg);
+
+		SimLog(level, "%s", msg);
+	}
+
+
+ }
+
+
+ // Flecs workers split the entity systems, the job pool runs the contact batches
+ void SetSimulationThreads(flecs::world& world, int threads)
+ {
+    world.set_threads(threads);
+    SimulationState& state = GetSimulationState(world);
+    SimulationInternals& internals = *state.internals;
+    internals.jobPool.SetThreadCount(threads);
+    internals.commandBuffers.resize(std::max(threads, 1));
+    state.particles.SetEmitterThreads(threads);
+    internals.bodyStatsPass.SetThreads(threads);
+    internals.contactStatsPass.SetThreads(threads);
+    internals.cellStatsPass.SetThreads(threads);
+ }
+
+
+ flecs::world* CreateSimulationWorld()
+ {
+	InstrumentFlecsAllocations();
+	flecs::world* world = new flecs::world();
+
+	ecs_os_api.log_ = OnFlecsLogCallback;
+
+	flecs::log::set_level(3);
+
+    world->set<SimulationWorld>({ std::make_unique<SimulationState>() });
+    SetSimulationThreads(*world, 4);
+    return world;
+ }
+
+
+ // --- Modules ---
+ // Components are registered at the root rather than in the scope of whichever module imports
+ // SimCore first, so their names (and the JSON that uses them) never depend on import order
+ static void RegisterSimulationComponents(flecs::world& world)
+ {
+    const flecs::entity_t scope = world.set_scope(0);
+    RegisterPoolableComponents(world);
+    world.component<Velocity>();
+    world.component<ColorComp>();
+    world.component<CollisionResponse>();
+    world.component<Radius>();
+    world.component<Mass>();
+    world.component<Restitution>();
+    world.component<Lifetime>();
+    world.component<Spark>();
+    world.component<SimClock>();
+    world.component<SimTime>();
+    world.component<LodMid>();
+    world.component<LodFar>();
+    world.component<LodBand>();
+    world.component<SpatialCell>();
+    world.component<GameState>();
+    world.component<SimulationWorld>();
+    world.set_scope(scope);
+ }
+
+ SimCore::SimCore(flecs::world& world)
+ {
+    RegisterSimulationComponents(world);
+    world.module<SimCore>();
+
+    prePhysics = world.entity("PrePhysics").add(flecs::Phase);
+    physics = world.entity("Physics").add(flecs::Phase).depends_on(prePhysics);
+    postPhysics = world.entity("PostPhysics").add(flecs::Phase).depends_on(physics);
+
+    DeclareGameStateObserver(world);
+
+    // first in the first phase, so every system on a periodic source sees this frame's tick
+    DeclareAdvancePeriodicJobsSystem(world, prePhysics);
+
+    // Post-physics: structural work. Expiry queues its despawns, then every queued despawn and
+    // spawn is applied in bulk; a spawn is simulated for a frame before it can expire
+    DeclareExpireLifetimesSystem(world, postPhysics);
+    DeclareFlushCommandBuffersSystem(world, postPhysics);
+
+    // singletons; the state is already there in a world from CreateSimulationWorld
+    world.set<GameState>({});
+    world.set<SimTime>({});
+    if (!world.has<SimulationWorld>())
+        world.set<SimulationWorld>({ std::make_unique<SimulationState>() });
+ }
+
+ SpatialIndex::SpatialIndex(flecs::world& world)
+ {
+    world.import<SimCore>();
+    const SimCore& core = world.get<SimCore>();
+    world.module<SpatialIndex>();
+
+    DeclareUpdateSpatialCellSystem(world, core.prePhysics);
+    DeclareBuildFluidGridSystem(world, core.prePhysics);
+ }
+
+ Physics::Physics(flecs::world& world)
+ {
+    world.import<SimCore>();
+    world.import<SpatialIndex>();
+    const SimCore& core = world.get<SimCore>();
+    world.module<Physics>();
+
+#ifdef PHYSICS_HOT_RELOAD
+    DeclareHotReloadedPhysicsSystems(world, core); // from the MyProjectPhysics module, see hot_reload.h
+#else
+    DeclarePhysicsSystems(world, core);
+#endif
+
+    ApplySimulationMode(world);
+ }
+
+ Render::Render(flecs::world& world)
+ {
+    world.import<SimCore>();
+    const SimCore& core = world.get<SimCore>();
+    world.module<Render>();
+
+    // Cosmetic particles live outside the ECS, these only feed and step SimulationState::particles
+    DeclareEmitTrailsSystem(world, core.postPhysics);
+    DeclareUpdateParticlesSystem(world, core.postPhysics);
+
+    // cached, the renderer walks them every frame
+    bodies = world.query_builder<const Position, const ColorComp, const Radius>()
+        .without<Spark>()
+        .cache_kind(flecs::QueryCacheAuto)
+        .build();
+    sparks = world.query_builder<const Position, const ColorComp, const Radius>()
+        .with<Spark>()
+        .cache_kind(flecs::QueryCacheAuto)
+        .build();
+ }
+
+ Stats::Stats(flecs::world& world)
+ {
+    world.import<SimCore>();
+    const SimCore& core = world.get<SimCore>();
+    world.module<Stats>();
+
+    // Sampled stats, each on its own periodic source
+    DeclareSampleSceneCountsSystem(world, core.postPhysics);
+    DeclareSampleBroadphaseOccupancySystem(world, core.postPhysics);
+    DeclareCombineFrameStatsSystem(world, core.postPhysics);
+    GetSimulationState(world).internals->frameStatsEnabled = true;
+ }
+
+ void DeclareECS(flecs::world& world)
+ {
+    world.import<SimCore>();
+    world.import<SpatialIndex>();
+    world.import<Physics>();
+    world.import<Render>();
+    world.import<Stats>();
+ }
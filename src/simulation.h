@@ -0,0 +1,378 @@
+#pragma once
+
+#include "flecs.h"
+#include "raylib.h"  // Vector3, Color and the LOG_* levels; the library never calls into raylib
+#include "raymath.h" // header-only
+#include "particles.h"
+#include "periodic_scheduler.h"
+#include "timing_wheel.h"
+
+#include <cstdarg>
+#include <memory>
+#include <string>
+#include <vector>
+
+// --- Simulation core ---
+// Components, simulation systems and the spatial structures behind them, built as the
+// MyProjectSim library and shared by the windowed app, the benchmark and the tools. Nothing in
+// here opens a window or draws; rendering and the GUI stay in main.cpp.
+
+// --- Logging ---
+// Same signature as raylib's TraceLogCallback, so the app hands one logger to both. Without a
+// callback, messages go to stderr.
+typedef void (*SimLogCallback)(int msgType, const char* text, va_list args);
+void SetSimLogCallback(SimLogCallback callback);
+void SimLog(int msgType, const char* text, ...);
+const char* GetLogMsgTypeAsString(int msgType);
+
+enum class SimulationMode : int
+{
+    Bounce = 0, // circles bouncing off each other (DetectEntitiesCollision)
+    Fluid = 1,  // smoothed-particle hydrodynamics over the neighbour grid
+};
+
+// What a Bounce contact spawns
+enum class CollisionEffect : int
+{
+    None = 0,
+    SparkEntities = 1, // Spark entities through the deferred command buffers
+    Particles = 2,     // cosmetic sparks in SimulationState::particles, no entities at all
+};
+
+// How entity/entity contacts are resolved in SimulationMode::Bounce
+enum class CollisionSolver : int
+{
+    OneShot = 0,          // reflect + half-overlap correction, accumulated in CollisionResponse
+    SequentialImpulse = 1, // iterative impulses with mass and restitution, parallel over contact colors
+};
+
+// Whether entities share GameState::entitySize and unit mass, or carry their own Radius/Mass
+enum class RadiusModel : int
+{
+    Uniform = 0,
+    PerEntity = 1,
+};
+
+// Neighbour lookup used by the Bounce collision systems
+enum class BroadphaseKind : int
+{
+    HashBuckets = 0, // sparse map of cells, unbounded
+    SortedGrid = 1,  // dense counting-sorted grid over the arena (DenseCellGrid)
+};
+
+// Scalar type the collision kernels compute in; components stay float
+enum class Precision : int
+{
+    Float = 0,
+    Double = 1,
+    FixedContacts = 2, // 48.16 integer contact math only (fixed_point.h), bodies are stored and integrated as float
+};
+
+struct GameState
+{
+    bool renderEntities = true;
+    float gridSize = 250.0f;
+	float entitySize = 10.0f;
+	float entitySpeed = 1500.0f;
+
+    SimulationMode simulationMode = SimulationMode::Bounce;
+
+    RadiusModel radiusModel = RadiusModel::Uniform;
+    float radiusVariation = 0.5f; // PerEntity spawns pick entitySize * [1 - variation, 1 + variation]
+    float spawnLifetime = 0.0f;   // seconds before a CreateEntity spawn expires, 0 = until removed
+    float maxEntityRadius = 10.0f; // largest Radius spawned so far, sizes the broadphase cells
+    CollisionSolver collisionSolver = CollisionSolver::OneShot;
+    CollisionEffect collisionEffect = CollisionEffect::None;
+    int sparksPerContact = 4;
+    bool particleTrails = false; // every moving body sheds a particle per frame
+    float particleDrag = 2.0f;
+
+    // Collision kernel variant, see CollisionPolicy
+    int dimensions = 2; // 3: bodies spawn through a cube, collide along Z and bounce off its Z walls (fluid stays 2D)
+    BroadphaseKind broadphase = BroadphaseKind::HashBuckets;
+    Precision precision = Precision::Float;
+
+    // Bitwise-identical results on any thread count and either broadphase: bodies are processed
+    // in entity id order and per-body sums run over contacts sorted by id. Costs a sort per pass.
+    // Collision effects (sparks, particles) stay outside the guarantee.
+    bool deterministic = false;
+
+    // Simulation LOD: bodies farther than lodNearRadius from lodFocus (the camera target) are
+    // integrated and collided every SIM_LOD_MID_RATE frames, beyond lodFarRadius every
+    // SIM_LOD_FAR_RATE frames, in substeps when the longer step would let bodies pass each other
+    bool simulationLod = false;
+    Vector3 lodFocus = { 0, 0, 0 };
+    float lodNearRadius = 300.0f;
+    float lodFarRadius = 800.0f;
+
+    // pulls along -Y; used by the fluid and the impulse solver (one-shot keeps constant speed)
+    float gravity = 0.0f;
+
+    // Sequential impulse solver parameters (only used with CollisionSolver::SequentialImpulse)
+    int solverVelocityIterations = 8;
+    int solverPositionIterations = 3;
+    float solverPositionCorrection = 0.2f; // fraction of the penetration removed per iteration
+    float solverPenetrationSlop = 0.5f;    // penetration left alone so resting contacts stay touching
+
+    // SPH parameters (only used in SimulationMode::Fluid)
+    float fluidSmoothingRadius = 20.0f;
+    float fluidParticleMass = 1.0f;
+    float fluidRestDensity = 0.010f;
+    float fluidStiffness = 100000.0f;
+    float fluidViscosity = 250.0f;
+};
+
+// --- Spatial grid cell index for broadphase collision
+struct SpatialCell { int cellX; int cellY; int cellZ; }; // cellZ is 0 unless GameState::dimensions == 3
+
+// --- Components ---
+struct Position { Vector3 value; };
+struct Velocity { Vector3 value; };
+struct ColorComp
+{
+    Color value;
+};
+
+// Index of the entity in this frame's FluidGrid gather order
+struct FluidParticle { int gridIndex = -1; };
+
+// Accumulated collision response to apply after broadphase/border checks
+struct CollisionResponse
+{
+    Vector3 posDelta{ 0, 0, 0 };
+    Vector3 velDelta{ 0, 0, 0 };
+    bool hasCollision{ false };
+};
+
+// Only read with RadiusModel::PerEntity, see EntityShape
+struct Radius { float value = 10.0f; };
+struct Mass { float value = 1.0f; };
+
+// Used by the impulse solver; the one-shot response is always elastic
+struct Restitution { float value = 0.8f; };
+
+// Time to live, written through SetLifetime which schedules the entity in the lifetime wheel;
+// ExpireLifetimes parks it in the entity pool once expired. seconds <= 0 lives until removed.
+struct Lifetime
+{
+    float seconds = 0.0f;
+    uint64_t expiryTick = 0; // wheel tick it was scheduled for, stale wheel entries do not match
+};
+
+// Cosmetic entity spawned by collisions: moves and expires, but never collides
+struct Spark {};
+
+// Simulation time the entity was last integrated at. LOD levels step at different rates, so
+// MoveEntities integrates whatever time the entity is owed, which also covers an entity that
+// just moved into a faster level mid-cycle.
+struct SimClock { double lastStep = 0.0; };
+
+// Singleton: clamped simulation time, advanced once per frame by AdvanceSimTime
+struct SimTime { double seconds = 0.0; };
+
+// LOD level tags, level 0 (near) has neither. Only changed when an entity crosses a boundary.
+struct LodMid {};
+struct LodFar {};
+// Within reach of an LOD boundary: the neighbouring level's collision pass sees the body as well
+struct LodBand {};
+
+static const int SIM_LOD_MID_RATE = 2;
+static const int SIM_LOD_FAR_RATE = 4;
+
+// Entity counts for the GUI, sampled a few times per second instead of counted every draw
+struct SceneCounts
+{
+    int entities = 0; // active bodies, sparks not included
+    int pooled = 0;
+    int sparks = 0;
+    int lodMid = 0;
+    int lodFar = 0;
+};
+
+// Last frame's impulse solver figures, shown in the GUI
+struct CollisionStats
+{
+    int contactCount = 0;
+    int colorCount = 0;
+};
+
+struct MomentumSum
+{
+    double x = 0.0, y = 0.0, z = 0.0;
+};
+
+// Bodies per occupied cell, bins[k] counts cells holding [2^k, 2^(k+1)) bodies
+static const int OCCUPANCY_BINS = 7;
+struct OccupancyHistogram
+{
+    int occupiedCells = 0;
+    int maxPerCell = 0;
+    int bodies = 0;
+    int bins[OCCUPANCY_BINS] = {};
+};
+
+// Fused frame statistics, published by CombineFrameStats (occupancy by its own sampling
+// system). References to the reduction totals, valid as long as the state.
+struct FrameStats
+{
+    const int& bodies;
+    const double& kineticEnergy;
+    const MomentumSum& momentum;
+    const float& maxSpeed;
+    const int& contacts;
+    const OccupancyHistogram& occupancy;
+};
+
+// --- Per-world simulation state ---
+// Everything the systems keep between frames belongs to one world: CreateSimulationWorld() gives
+// each world a SimulationWorld singleton owning its state, so two worlds share no pool, buffer,
+// scheduler, job pool or statistic and can be stepped side by side. What only the library
+// touches (entity pool, command buffers, broadphase, ...) is in the internals, simulation.cpp.
+struct SimulationInternals;
+
+struct SimulationState
+{
+    std::unique_ptr<SimulationInternals> internals; // first, the statistics refer into it
+
+    PeriodicScheduler periodicJobs; // staggered tick sources for everything below frame rate
+    SceneCounts sceneCounts;
+    CollisionStats collisionStats;
+    ParticleSystem particles;       // cosmetic particles, outside the ECS
+    TimingWheel lifetimeWheel;
+    const FrameStats stats;
+
+    SimulationState();
+    ~SimulationState();
+    SimulationState(const SimulationState&) = delete;
+    SimulationState& operator=(const SimulationState&) = delete;
+};
+
+// The singleton. The state itself stays on the heap: the job pool's threads and the statistics
+// references must not move along with Flecs' component storage.
+struct SimulationWorld
+{
+    std::unique_ptr<SimulationState> state;
+};
+
+SimulationState& GetSimulationState(const flecs::world& world);
+
+// Buckets of the sparse cell map, a change between frames means it rehashed
+size_t CellBucketCount(const flecs::world& world);
+
+// --- Simulation LOD ---
+// The collision passes and MoveEntities are declared once per LOD level. Level 0 runs every
+// frame on the untagged entities; the other levels match LodMid/LodFar and are ticked by a
+// periodic source, so a far region is neither collided nor integrated on the frames it is not
+// stepped. A level's pass also gathers the LodBand bodies of the other levels as read-only
+// ghosts, so bodies on either side of a boundary still meet: each side responds in its own pass.
+struct SimLod
+{
+    int level = 0;
+    flecs::entity tickSource; // SimulationState::periodicJobs source, levels > 0 only
+};
+
+// --- Helper Functions ---
+float GetRandomFloat(float min, float max);
+float GetThreadRandomFloat(float min, float max);
+Color GetRandomColor();
+
+// --- World setup ---
+// A world with its SimulationState, the Flecs log hooked to SimLog and 4 simulation threads; no
+// module imported yet
+flecs::world* CreateSimulationWorld();
+// Flecs workers, the job pool and every per-thread buffer
+void SetSimulationThreads(flecs::world& world, int threads);
+// Imports every module below, for the app and the benchmark
+void DeclareECS(flecs::world& world);
+// Enables the systems of the active simulation mode / solver and disables the others
+void ApplySimulationMode(flecs::world& world);
+
+// --- Entities ---
+flecs::entity SpawnEntity(flecs::world& world, const Vector3& position, const Vector3& velocity, float radius, float lifetimeSeconds);
+void CreateEntity(flecs::world& world);
+// radii empty = every body gets GameState::entitySize
+void BulkSpawnEntities(flecs::world& world, std::vector<Position>& positions, std::vector<Velocity>& velocities, const std::vector<Radius>& radii = {});
+void ReleaseEntity(flecs::entity e);
+void ReleaseAllEntities(flecs::world& world);
+void TrimEntityPool(flecs::world& world);
+int PooledEntityCount(const flecs::world& world);
+
+// --- Scenes ---
+void SpawnBounceScene(flecs::world& world, int count);
+void SpawnFluidScene(flecs::world& world, int count);
+
+// Spawn/expire stress: `count` short-lived entities spread over `frames` frames
+struct ChurnScene
+{
+    int perFrame = 0;
+    long long spawned = 0;
+    long long total = 0;
+};
+
+ChurnScene SetupChurnScene(flecs::world& world, int count, int frames);
+void SpawnChurnWave(flecs::world& world, ChurnScene& scene);
+
+// --- Systems ---
+void DeclareGameStateObserver(flecs::world& world);
+void DeclareAdvancePeriodicJobsSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareSimLodSystems(flecs::world& world, const flecs::entity& inPhase);
+void DeclareUpdateSpatialCellSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareBuildFluidGridSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareComputeFluidDensitySystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareApplyFluidForcesSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareDetectEntitiesCollision(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod = {});
+void DeclareDetectGridEntityCollision(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod = {});
+void DeclareSolveContactsSystem(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod = {});
+void DeclareApplyCollisionResponseSystem(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod = {});
+void DeclareMoveEntitiesSystem(flecs::world& world, const flecs::entity& inPhase, const SimLod& lod = {});
+void DeclareFlushCommandBuffersSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareExpireLifetimesSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareEmitTrailsSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareUpdateParticlesSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareSampleSceneCountsSystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareSampleBroadphaseOccupancySystem(flecs::world& world, const flecs::entity& inPhase);
+void DeclareCombineFrameStatsSystem(flecs::world& world, const flecs::entity& inPhase);
+
+// --- Modules ---
+// The systems grouped by what they are for. Each module imports what it depends on, so a headless
+// server imports Physics (which brings SpatialIndex and SimCore along) and a viewer only Render;
+// nothing it did not import is registered or run. Systems live in their module's scope
+// ("Physics::MoveEntities") and run in SimCore's phases, in import order within a phase.
+
+// Phases, components, the GameState singleton and the structural systems the others rely on:
+// periodic tick sources, the command buffer flush and lifetime expiry
+struct SimCore
+{
+    flecs::entity prePhysics;
+    flecs::entity physics;
+    flecs::entity postPhysics;
+
+    explicit SimCore(flecs::world& world);
+};
+
+// SpatialCell assignment and the fluid grid gather
+struct SpatialIndex
+{
+    explicit SpatialIndex(flecs::world& world);
+};
+
+// LOD, collision, the contact solver, SPH forces and integration
+struct Physics
+{
+    explicit Physics(flecs::world& world);
+};
+
+// Cosmetic particles and the cached queries the renderer draws from
+struct Render
+{
+    flecs::query<const Position, const ColorComp, const Radius> bodies; // without Spark
+    flecs::query<const Position, const ColorComp, const Radius> sparks;
+
+    explicit Render(flecs::world& world);
+};
+
+// Scene counts, broadphase occupancy and the fused frame statistics (SimulationState::stats)
+struct Stats
+{
+    explicit Stats(flecs::world& world);
+};
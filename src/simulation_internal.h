@@ -0,0 +1,414 @@
+#pragma once
+
+#include "simulation.h"
+#include "job_pool.h"
+#include "reductions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --- Library-internal simulation state ---
+// What simulation.cpp and physics.cpp share beyond the public API: the broadphase and fluid
+// structures, the job pool and the statistics the collision passes feed. They are part of each
+// world's SimulationInternals, which lives in simulation.cpp and is only reached through the
+// accessors below, so with ENABLE_HOT_RELOAD it stays in the app while physics.cpp is reloaded
+// around it (see hot_reload.h). Not for the app or the tools.
+
+// 21 bits per axis: exact within a million cells of the origin, beyond that distant cells share
+// a bucket, whose foreign bodies ForEachCandidate skips
+inline long long CellKey(int x, int y, int z = 0)
+{
+    const auto axis = [](int c) { return static_cast<unsigned long long>(c) & 0x1FFFFFull; };
+    return static_cast<long long>((axis(x) << 42) | (axis(y) << 21) | axis(z));
+}
+
+// Mass of a body of the given radius, same density for every size: the area ratio to an
+// entitySize body in 2D, the volume ratio in 3D
+inline float BodyMass(const GameState& game_state, float radius)
+{
+    const float ratio = radius / game_state.entitySize;
+    return game_state.dimensions == 3 ? ratio * ratio * ratio : ratio * ratio;
+}
+
+// Broadphase cell size: two radii when bouncing, the smoothing radius for SPH
+inline float GetCellSize(const GameState& game_state)
+{
+    if (game_state.simulationMode == SimulationMode::Fluid)
+    {
+        return std::max(game_state.fluidSmoothingRadius, 1.0f);
+    }
+    const float radius = game_state.radiusModel == RadiusModel::PerEntity ? game_state.maxEntityRadius : game_state.entitySize;
+    return std::max(radius * 2.0f, 1.0f);
+}
+
+// Z only in 3D scenes: a 2D scene ignores Z, so bodies left off the plane must share their cells
+inline SpatialCell ComputeCell(const Vector3& p, float cellSize, bool depth)
+{
+    const int cx = static_cast<int>(std::floor(p.x / cellSize));
+    const int cy = static_cast<int>(std::floor(p.y / cellSize));
+    const int cz = depth ? static_cast<int>(std::floor(p.z / cellSize)) : 0;
+    return { cx, cy, cz };
+}
+
+// --- Dense cell grid over the arena, counting-sorted (rebuilt every frame)
+// Items are added in gather order; Sort() gives each one a slot so that items of the same cell
+// are contiguous. Items pushed slightly outside the arena are clamped into the border cells.
+// A single layer of cells unless Reset() is asked for depth (3D collision scenes). The cell count
+// of a cube grows with the cube of the arena, so past MAX_CELLS_3D neighbouring cells are merged
+// (coarsen per axis): larger cells still hold every pair of the 3x3x3 neighbourhood.
+struct DenseCellGrid
+{
+    static constexpr long long MAX_CELLS_3D = 1 << 24;
+
+    float cellSize = 1.0f; // of the cell coordinates passed in
+    int coarsen = 1;       // input cells per grid cell and axis
+    int minCellX = 0;
+    int minCellY = 0;
+    int minCellZ = 0;
+    int cellsX = 0;
+    int cellsY = 0;
+    int cellsZ = 1;
+    std::vector<int> cellStart; // cellsX * cellsY * cellsZ + 1 offsets into the sorted order
+    std::vector<int> cellOf;    // gather index -> cell
+    std::vector<int> slotOf;    // gather index -> sorted slot
+    std::vector<int> itemAt;    // sorted slot -> gather index
+
+    void Reset(float arenaHalfSize, float newCellSize, bool depth = false)
+    {
+        cellSize = newCellSize;
+        const int lowCell = static_cast<int>(std::floor(-arenaHalfSize / cellSize));
+        const int highCell = static_cast<int>(std::floor(arenaHalfSize / cellSize));
+        coarsen = 1;
+        while (depth && std::pow(static_cast<double>((highCell - lowCell) / coarsen + 4), 3.0) > MAX_CELLS_3D)
+        {
+            ++coarsen;
+        }
+        minCellX = Coarse(lowCell) - 1;
+        minCellY = minCellX;
+        cellsX = Coarse(highCell) - minCellX + 2;
+        cellsY = cellsX;
+        minCellZ = depth ? minCellX : 0;
+        cellsZ = depth ? cellsX : 1;
+        cellStart.assign(static_cast<size_t>(cellsX) * cellsY * cellsZ + 1, 0);
+        cellOf.clear();
+    }
+
+    int CellIndex(int cellX, int cellY, int cellZ = 0) const
+    {
+        const int x = std::clamp(Coarse(cellX) - minCellX, 0, cellsX - 1);
+        const int y = std::clamp(Coarse(cellY) - minCellY, 0, cellsY - 1);
+        const int z = std::clamp(Coarse(cellZ) - minCellZ, 0, cellsZ - 1);
+        return (z * cellsY + y) * cellsX + x;
+    }
+
+    // floor(cell / coarsen), also for negative cells
+    int Coarse(int cell) const
+    {
+        return cell >= 0 ? cell / coarsen : -((-cell + coarsen - 1) / coarsen);
+    }
+
+    // Returns the gather index of the new item
+    int Add(int cellX, int cellY, int cellZ = 0)
+    {
+        const int cell = CellIndex(cellX, cellY, cellZ);
+        cellOf.push_back(cell);
+        cellStart[cell + 1]++;
+        return static_cast<int>(cellOf.size()) - 1;
+    }
+
+    void Sort()
+    {
+        for (size_t c = 1; c < cellStart.size(); ++c)
+        {
+            cellStart[c] += cellStart[c - 1];
+        }
+
+        const size_t count = cellOf.size();
+        slotOf.resize(count);
+        itemAt.resize(count);
+        std::vector<int> cursor(cellStart.begin(), cellStart.end() - 1);
+        for (size_t g = 0; g < count; ++g)
+        {
+            const int slot = cursor[cellOf[g]]++;
+            slotOf[g] = slot;
+            itemAt[slot] = static_cast<int>(g);
+        }
+    }
+
+    // Calls fn(slot) for every item in the 3x3 (3x3x3 with depth) cells around cell
+    template<typename Fn>
+    void ForEachNeighbourSlot(int cell, Fn&& fn) const
+    {
+        const int cx = cell % cellsX;
+        const int cy = (cell / cellsX) % cellsY;
+        const int cz = cell / (cellsX * cellsY);
+        for (int nz = std::max(cz - 1, 0); nz <= std::min(cz + 1, cellsZ - 1); ++nz)
+        {
+            for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, cellsY - 1); ++ny)
+            {
+                for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, cellsX - 1); ++nx)
+                {
+                    const int neighbourCell = (nz * cellsY + ny) * cellsX + nx;
+                    const int end = cellStart[neighbourCell + 1];
+                    for (int j = cellStart[neighbourCell]; j < end; ++j)
+                    {
+                        fn(j);
+                    }
+                }
+            }
+        }
+    }
+};
+
+// --- SoA snapshot of the fluid particles, sorted by grid cell (rebuilt every frame)
+// Neighbour loops of the density and force passes walk contiguous float arrays instead of
+// chasing entity handles through the hash buckets.
+struct FluidGrid
+{
+    DenseCellGrid cells;
+
+    // indexed by sorted slot
+    std::vector<float> posX, posY;
+    std::vector<float> velX, velY;
+    std::vector<float> density, pressure;
+
+    // gather staging, kept around to avoid reallocating every frame
+    std::vector<float> gatherPosX, gatherPosY;
+    std::vector<float> gatherVelX, gatherVelY;
+    std::vector<int> gatherCellX, gatherCellY;
+    std::vector<FluidParticle*> gatherParticle;
+    std::vector<uint64_t> gatherId;
+    std::vector<int> addOrder; // order the gathered particles enter the grid
+};
+
+// 2D SPH kernel constants (Mueller et al. 2003, normalised for the plane). The spiky kernel is
+// W(r) = 10 / (pi h^5) (h - r)^3, so its gradient has three times that constant.
+struct FluidKernel
+{
+    float h;
+    float h2;
+    float poly6;     // W(r)     = poly6 * (h^2 - r^2)^3
+    float spikyGrad; // |dW/dr|  = spikyGrad * (h - r)^2
+    float viscLap;   // lap W(r) = viscLap * (h - r)
+
+    explicit FluidKernel(float smoothingRadius)
+        : h(smoothingRadius)
+        , h2(smoothingRadius * smoothingRadius)
+        , poly6(4.0f / (PI * std::pow(smoothingRadius, 8.0f)))
+        , spikyGrad(30.0f / (PI * std::pow(smoothingRadius, 5.0f)))
+        , viscLap(40.0f / (PI * std::pow(smoothingRadius, 5.0f)))
+    {
+    }
+};
+
+
+// --- Broadphase: candidate neighbours of a body from the 3x3 cells around it
+// (3x3x3 in 3D scenes: cellZ is filled then, and empty for 2D ones)
+template<BroadphaseKind Kind>
+struct BroadphaseGrid;
+
+// Dense counting-sorted grid over the arena, neighbour cells are contiguous slot ranges
+template<>
+struct BroadphaseGrid<BroadphaseKind::SortedGrid>
+{
+    DenseCellGrid cells;
+
+    void Build(const std::vector<int>& cellX, const std::vector<int>& cellY, const std::vector<int>& cellZ, float arenaHalfSize, float cellSize)
+    {
+        const bool depth = !cellZ.empty();
+        cells.Reset(arenaHalfSize, cellSize, depth);
+        for (size_t i = 0; i < cellX.size(); ++i)
+        {
+            cells.Add(cellX[i], cellY[i], depth ? cellZ[i] : 0);
+        }
+        cells.Sort();
+    }
+
+    template<typename Fn>
+    void ForEachCandidate(int body, Fn&& fn) const
+    {
+        cells.ForEachNeighbourSlot(cells.cellOf[body], [&](int slot) { fn(cells.itemAt[slot]); });
+    }
+};
+
+// Sparse hash of cells, no arena bound. Buckets keep their capacity between frames and the map
+// is only dropped when it grew far beyond the number of bodies.
+template<>
+struct BroadphaseGrid<BroadphaseKind::HashBuckets>
+{
+    std::unordered_map<long long, std::vector<int>> buckets; // collision body indices per cell
+    const std::vector<int>* cellX = nullptr;
+    const std::vector<int>* cellY = nullptr;
+    const std::vector<int>* cellZ = nullptr; // nullptr in 2D scenes
+
+    void Build(const std::vector<int>& bodyCellX, const std::vector<int>& bodyCellY, const std::vector<int>& bodyCellZ, float /*arenaHalfSize*/, float /*cellSize*/)
+    {
+        cellX = &bodyCellX;
+        cellY = &bodyCellY;
+        cellZ = bodyCellZ.empty() ? nullptr : &bodyCellZ;
+
+        if (buckets.size() > bodyCellX.size() * 4 + 64)
+        {
+            buckets.clear();
+        }
+        for (auto& [key, bucket] : buckets)
+        {
+            bucket.clear();
+        }
+        for (size_t i = 0; i < bodyCellX.size(); ++i)
+        {
+            buckets[CellKey(bodyCellX[i], bodyCellY[i], cellZ ? bodyCellZ[i] : 0)].push_back(static_cast<int>(i));
+        }
+    }
+
+    template<typename Fn>
+    void ForEachCandidate(int body, Fn&& fn) const
+    {
+        const int z = cellZ ? (*cellZ)[body] : 0;
+        const int layers = cellZ ? 1 : 0;
+        for (int dz = -layers; dz <= layers; ++dz)
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    const int x = (*cellX)[body] + dx;
+                    const int y = (*cellY)[body] + dy;
+                    auto it = buckets.find(CellKey(x, y, z + dz));
+                    if (it == buckets.end()) continue;
+
+                    for (int other : it->second)
+                    {
+                        // an aliased cell a million cells away: too far for the kernels'
+                        // distance math, fixed-point products included
+                        if ((*cellX)[other] != x || (*cellY)[other] != y || (cellZ && (*cellZ)[other] != z + dz)) continue;
+                        fn(other);
+                    }
+                }
+            }
+        }
+    }
+};
+
+// --- SoA snapshot of the colliding bodies, in query order (rebuilt every frame)
+// Work buffers of the collision kernels in physics.cpp, one set per world and Real
+template<typename Real>
+struct CollisionBodies
+{
+    std::vector<Real> posX, posY, posZ;
+    std::vector<Real> velX, velY, velZ;
+    std::vector<Real> radius; // RadiusModel::PerEntity only
+    std::vector<Real> invMass;
+    std::vector<Real> restitution;
+    std::vector<int> cellX, cellY;
+    std::vector<int> cellZ; // 3D policies only
+
+    // LOD level of the pass, and per body: its substep (0 for ghosts, which stand still) and
+    // 0 for the level's own bodies or 1 + the level of a LodBand ghost, never written back
+    int level = 0;
+    std::vector<Real> step;
+    std::vector<uint8_t> ghost;
+
+    // one-shot responses, per body
+    std::vector<Real> dPosX, dPosY, dPosZ;
+    std::vector<Real> dVelX, dVelY, dVelZ;
+    std::vector<uint8_t> touched;
+
+    // component arrays of the tables visited while gathering, for the write-back
+    struct TableChunk { Position* p; Velocity* v; CollisionResponse* r; SimClock* clock; int count; };
+    std::vector<TableChunk> chunks;
+
+    // deterministic mode only: entity ids, and where SortBodiesById moved each gathered body
+    std::vector<uint64_t> id;
+    std::vector<int> slotOf; // gather index -> body, empty = same order
+
+    // SortBodiesById staging, one array per element type it permutes
+    std::vector<int> order;
+    std::vector<Real> sortedReal;
+    std::vector<int> sortedInt;
+    std::vector<uint64_t> sortedId;
+    std::vector<uint8_t> sortedFlag;
+
+    int Count() const { return static_cast<int>(posX.size()); }
+    int SlotOf(int gathered) const { return slotOf.empty() ? gathered : slotOf[gathered]; }
+
+    // A contact with a ghost is found by the passes of both levels, the finer one reports it
+    bool Reports(int a, int b) const
+    {
+        const auto reportedBy = [&](int body) { return ghost[body] == 0 || ghost[body] - 1 > level; };
+        return reportedBy(a) && (b < 0 || reportedBy(b));
+    }
+
+    void Clear()
+    {
+        posX.clear(); posY.clear(); posZ.clear();
+        velX.clear(); velY.clear(); velZ.clear();
+        radius.clear();
+        invMass.clear();
+        restitution.clear();
+        cellX.clear(); cellY.clear(); cellZ.clear();
+        step.clear();
+        ghost.clear();
+        chunks.clear();
+        id.clear();
+        slotOf.clear();
+    }
+};
+
+// --- Sequential impulse contacts (rebuilt every frame)
+template<typename Real>
+struct SolverContact
+{
+    int a = -1;
+    int b = -1;                    // second body, or -1 for an arena wall
+    Real nx = 0, ny = 0, nz = 0;   // normal from a towards b (or towards the wall)
+    Real wallOffset = 0;           // wall plane dot(n, p) = wallOffset, walls only
+    Real bounce = 0;               // separating speed target from restitution
+    Real impulse = 0;              // accumulated normal impulse, kept >= 0
+};
+
+template<typename Real>
+struct ContactSolver
+{
+    std::vector<SolverContact<Real>> contacts;
+    std::vector<uint8_t> contactColor;
+    std::vector<SolverContact<Real>> colored; // contacts grouped by color
+    std::vector<int> colorStart;              // MAX_CONTACT_COLORS + 2 offsets, last group is serial
+    std::vector<uint64_t> usedColors;         // per body
+    std::vector<uint8_t> touched;             // per body
+};
+
+// --- Per-world internals (see SimulationState) ---
+// The broadphase the collision kernels built last, read in place by SampleBroadphaseOccupancy
+template<BroadphaseKind Kind>
+BroadphaseGrid<Kind>& GetBroadphase(SimulationState& state);
+
+// Collision kernel work buffers of a precision (float, double or Fixed)
+template<typename Real>
+CollisionBodies<Real>& GetCollisionBodies(SimulationState& state);
+template<typename Real>
+ContactSolver<Real>& GetContactSolver(SimulationState& state);
+
+FluidGrid& GetFluidGrid(SimulationState& state);
+JobPool& GetJobPool(SimulationState& state);
+
+// Contacts found by one collision batch, combined by CombineFrameStats. nullptr until the Stats
+// module is imported: without it nothing would ever combine and reset the partials.
+ReductionPass<int>* GetContactStatsPass(SimulationState& state);
+
+// --- Simulation LOD ---
+inline std::string LodSystemName(const char* name, const SimLod& lod)
+{
+    return lod.level == 0 ? std::string(name) : std::format("{}Lod{}", name, lod.level);
+}
+
+// Sparks or particles for one contact, per GameState::collisionEffect; safe on any worker
+void EmitCollisionEffect(SimulationState& state, int threadIndex, const GameState& game_state, const Vector3& at);
+
+// The Physics module's systems (physics.cpp), declared in the module's scope
+void DeclarePhysicsSystems(flecs::world& world, const SimCore& core);
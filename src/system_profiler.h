@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "flecs.h"
+#include "instrumentation.h"
+#include "perf_counters.h"
+
+// --- Per-system profiler.
+// Install() swaps the run callback of every declared system for ProfiledRun, which samples the
+// wall clock and, when enabled, the calling thread's hardware counters around the original
+// callback. Nothing in the systems themselves changes. Multi-threaded systems are sampled on
+// every worker that runs a share of them, so their figures are summed CPU time, not latency.
+// With Tracy enabled each run is also a zone named after the system.
+class SystemProfiler
+{
+public:
+    struct SystemStats
+    {
+        std::string name;
+        uint64_t runs = 0;
+        double cpuMs = 0.0;
+        uint64_t counters[PERF_COUNTER_COUNT] = {};
+    };
+
+    // Call once every system has been declared; systems declared later are not profiled
+    // until the next Install or Refresh
+    void Install(flecs::world& world)
+    {
+        active = this;
+        for (flecs::entity e : Systems(world))
+        {
+            if (slots.count(e.id()))
+                continue;
+
+            const ecs_system_t* system = ecs_system_get(world, e);
+            auto slot = std::make_unique<Slot>();
+            slot->id = e.id();
+            slot->name = e.name().c_str();
+            slot->run = system->run;
+            slot->action = system->action;
+            slot->hasTerms = system->query && system->query->term_count > 0;
+            Wrap(world, *slot);
+
+            order.push_back(slot.get());
+            slots.emplace(e.id(), std::move(slot));
+        }
+    }
+
+    // After a hot reload (see hot_reload.h), between frames. A system declared again got the new
+    // module's callbacks in place: a run callback replaces ProfiledRun, an each callback replaces
+    // the action the slot would call. Either way the slot takes the new callbacks and the system
+    // is wrapped again, so nothing calls into the closed module. Slots of deleted systems are
+    // dropped and systems new in the build are installed.
+    void Refresh(flecs::world& world)
+    {
+        if (active != this)
+            return;
+
+        std::erase_if(order, [&](const Slot* slot) { return !ecs_is_alive(world, slot->id); });
+        std::erase_if(slots, [&](const auto& entry) { return !ecs_is_alive(world, entry.first); });
+
+        for (flecs::entity e : Systems(world))
+        {
+            const auto found = slots.find(e.id());
+            if (found == slots.end())
+                continue;
+
+            Slot& slot = *found->second;
+            const ecs_system_t* system = ecs_system_get(world, e);
+            const bool wrapped = system->run == ProfiledRun;
+            if (wrapped && system->action == slot.action)
+                continue;
+
+            if (!wrapped)
+                slot.run = system->run;
+            slot.action = system->action;
+            Wrap(world, slot);
+        }
+
+        Install(world);
+    }
+
+    // The run callback a system ends up calling: its own, or the one ProfiledRun wraps
+    ecs_run_action_t RunOf(flecs::world& world, flecs::entity e) const
+    {
+        const ecs_system_t* system = ecs_system_get(world, e);
+        if (!system)
+            return nullptr;
+        const auto found = slots.find(e.id());
+        return system->run == ProfiledRun && found != slots.end() ? found->second->run : system->run;
+    }
+
+    // Counters cost two read() syscalls per system run and thread, wall time is always sampled
+    void SetCountersEnabled(bool enabled)
+    {
+        countersEnabled = enabled && CountersAvailable();
+    }
+
+    bool CountersEnabled() const { return countersEnabled; }
+
+    // Probed on the calling thread, the workers open their own groups on first use
+    bool CountersAvailable() const { return PerfCounterGroup::ForThisThread().Available(); }
+    const std::string& CountersUnavailableReason() const { return PerfCounterGroup::ForThisThread().FailureReason(); }
+
+    // Closes the frame: the time each system took since the previous call goes to LastFrameMs()
+    void EndFrame()
+    {
+        ++frames;
+        lastFrameMs.resize(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            const uint64_t nanoseconds = order[i]->nanoseconds;
+            lastFrameMs[i] = static_cast<float>((nanoseconds - order[i]->frameStart) / 1.0e6);
+            order[i]->frameStart = nanoseconds;
+        }
+    }
+
+    uint64_t Frames() const { return frames; }
+
+    // Per system in Snapshot() order
+    const std::vector<float>& LastFrameMs() const { return lastFrameMs; }
+
+    void Reset()
+    {
+        for (Slot* slot : order)
+        {
+            slot->runs = 0;
+            slot->nanoseconds = 0;
+            slot->frameStart = 0;
+            for (std::atomic<uint64_t>& counter : slot->counters)
+            {
+                counter = 0;
+            }
+        }
+        frames = 0;
+    }
+
+    // Systems in pipeline declaration order
+    std::vector<SystemStats> Snapshot() const
+    {
+        std::vector<SystemStats> stats;
+        stats.reserve(order.size());
+        for (const Slot* slot : order)
+        {
+            SystemStats& s = stats.emplace_back();
+            s.name = slot->name;
+            s.runs = slot->runs;
+            s.cpuMs = slot->nanoseconds / 1.0e6;
+            for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter)
+            {
+                s.counters[counter] = slot->counters[counter];
+            }
+        }
+        return stats;
+    }
+
+private:
+    struct Slot
+    {
+        flecs::entity_t id = 0;
+        std::string name;
+        ecs_run_action_t run = nullptr;
+        ecs_iter_action_t action = nullptr;
+        bool hasTerms = true;
+
+        std::atomic<uint64_t> runs{ 0 };
+        std::atomic<uint64_t> nanoseconds{ 0 };
+        std::atomic<uint64_t> counters[PERF_COUNTER_COUNT] = {};
+        uint64_t frameStart = 0; // nanoseconds at the last EndFrame, main thread only
+    };
+
+    static std::vector<flecs::entity> Systems(flecs::world& world)
+    {
+        std::vector<flecs::entity> systems;
+        world.query_builder<>().with(flecs::System).build().each([&](flecs::entity e)
+        {
+            systems.push_back(e);
+        });
+        return systems;
+    }
+
+    // On an existing system this only replaces the callbacks, query and contexts stay
+    static void Wrap(flecs::world& world, const Slot& slot)
+    {
+        ecs_system_desc_t desc = {};
+        desc.entity = slot.id;
+        desc.run = ProfiledRun;
+        desc.callback = slot.action;
+        ecs_system_init(world, &desc);
+    }
+
+    // Same dispatch as Flecs does for a system without a run callback
+    static void RunOriginal(const Slot& slot, ecs_iter_t* it)
+    {
+        if (slot.run)
+        {
+            slot.run(it);
+        }
+        else if (slot.hasTerms)
+        {
+            while (ecs_iter_next(it))
+            {
+                slot.action(it);
+            }
+        }
+        else
+        {
+            slot.action(it);
+            ecs_iter_fini(it);
+        }
+    }
+
+    static void ProfiledRun(ecs_iter_t* it)
+    {
+        Slot& slot = *active->slots.at(it->system);
+        INSTRUMENT_ZONE_TEXT(slot.name.c_str(), slot.name.size());
+        PerfCounterGroup* group = active->countersEnabled ? &PerfCounterGroup::ForThisThread() : nullptr;
+
+        const PerfSample before = group ? group->Read() : PerfSample{};
+        const auto start = std::chrono::steady_clock::now();
+
+        RunOriginal(slot, it);
+
+        const auto end = std::chrono::steady_clock::now();
+        slot.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        ++slot.runs;
+        if (group)
+        {
+            const PerfSample after = group->Read();
+            for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter)
+            {
+                slot.counters[counter] += after.values[counter] - before.values[counter];
+            }
+        }
+    }
+
+    static inline SystemProfiler* active = nullptr;
+
+    std::unordered_map<flecs::entity_t, std::unique_ptr<Slot>> slots; // only changed between frames
+    std::vector<Slot*> order;
+    std::atomic<bool> countersEnabled{ false };
+    uint64_t frames = 0;
+    std::vector<float> lastFrameMs;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// --- Hierarchical timing wheel for timeouts keyed by a 64-bit id (entity ids here).
+// LEVELS wheels of SLOTS slots each; level k covers delays up to SLOTS^(k+1) ticks at a
+// resolution of SLOTS^k ticks. Scheduling is O(1), and advancing one tick only touches the
+// level-0 slot that expires plus, every SLOTS ticks, one higher-level slot that cascades down.
+// Per frame that is O(expired + cascaded) instead of a scan over every pending timeout.
+// Cancelling is left to the caller: keep the expiry tick returned by Schedule next to the
+// object and ignore callbacks whose tick no longer matches.
+class TimingWheel
+{
+public:
+    static constexpr int SLOT_BITS = 8;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+
+    explicit TimingWheel(double tickSeconds = 1.0 / 240.0)
+        : tickSeconds(tickSeconds)
+        , wheels(LEVELS, std::vector<std::vector<Entry>>(SLOTS))
+    {
+    }
+
+    // Schedules id to expire after delaySeconds (at least one tick), returns the expiry tick
+    uint64_t Schedule(uint64_t id, double delaySeconds)
+    {
+        const uint64_t delayTicks = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(delaySeconds / tickSeconds)), 1);
+        const uint64_t expiry = currentTick + delayTicks;
+        Insert({ id, expiry });
+        ++pending;
+        return expiry;
+    }
+
+    // Advances the wheel by deltaSeconds and calls onExpired(id, expiryTick) for every entry
+    // whose tick has passed, in tick order
+    template<typename Fn>
+    void Advance(double deltaSeconds, Fn&& onExpired)
+    {
+        accumulator += deltaSeconds;
+        while (accumulator >= tickSeconds)
+        {
+            accumulator -= tickSeconds;
+            Tick(onExpired);
+        }
+    }
+
+    uint64_t CurrentTick() const { return currentTick; }
+    size_t PendingCount() const { return pending; }
+
+    void Clear()
+    {
+        for (auto& wheel : wheels)
+        {
+            for (auto& slot : wheel)
+            {
+                slot.clear();
+            }
+        }
+        pending = 0;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t id;
+        uint64_t expiry;
+    };
+
+    static int SlotOf(uint64_t tick, int level)
+    {
+        return static_cast<int>((tick >> (level * SLOT_BITS)) & (SLOTS - 1));
+    }
+
+    void Insert(const Entry& entry)
+    {
+        const uint64_t delta = entry.expiry > currentTick ? entry.expiry - currentTick : 0;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (uint64_t(1) << ((level + 1) * SLOT_BITS)))
+        {
+            ++level;
+        }
+        // beyond the top level the entry parks in the farthest slot and is re-inserted when it comes round
+        wheels[level][SlotOf(entry.expiry, level)].push_back(entry);
+    }
+
+    // Re-inserts one higher-level slot; its entries land in lower levels relative to the new tick
+    void Cascade(int level)
+    {
+        std::vector<Entry>& slot = wheels[level][SlotOf(currentTick, level)];
+        scratch.swap(slot);
+        for (const Entry& entry : scratch)
+        {
+            Insert(entry);
+        }
+        scratch.clear();
+    }
+
+    template<typename Fn>
+    void Tick(Fn& onExpired)
+    {
+        ++currentTick;
+        for (int level = 1; level < LEVELS && SlotOf(currentTick, level - 1) == 0; ++level)
+        {
+            Cascade(level);
+        }
+
+        std::vector<Entry>& slot = wheels[0][SlotOf(currentTick, 0)];
+        firing.swap(slot);
+        for (const Entry& entry : firing)
+        {
+            if (entry.expiry > currentTick)
+            {
+                Insert(entry); // parked past the top level, not due yet
+                continue;
+            }
+            --pending;
+            onExpired(entry.id, entry.expiry);
+        }
+        firing.clear();
+    }
+
+    double tickSeconds;
+    double accumulator = 0.0;
+    uint64_t currentTick = 0;
+    size_t pending = 0;
+
+    std::vector<std::vector<std::vector<Entry>>> wheels;
+    std::vector<Entry> scratch;
+    std::vector<Entry> firing;
+};
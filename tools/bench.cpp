@@ -0,0 +1,8 @@
+#include "headless.h"
+
+// Standalone headless benchmark: the runs of `MyProject --bench`, built without raylib's window,
+// so it also works on machines without a display. See headless.h for the options.
+int main(int argc, char** argv)
+{
+    return RunHeadlessBenchmark(ParseLaunchOptions(argc, argv));
+}
@@ -0,0 +1,331 @@
+#include "headless.h"
+#include "scenario.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// --- Differential harness ---
+// MyProjectDiff <bench options> [--tolerance X] [--thread-counts 1,2,4,8]
+// Runs one seeded scene through every broadphase and precision backend and every thread count,
+// and compares each run's per-frame state against the reference run of its precision (hash
+// broadphase, one thread). Precisions are never compared with each other: float, double and
+// fixed contact math round differently, and a chaotic scene drifts apart by design, which would
+// bury the broadphase and threading differences this is for. The scene is a bounce --scenario
+// file.json, or --scene cell|lattice|blob|uniform with --count; the other bench options
+// (--solver, --dim, --frames) apply to every run. ctest runs it on a lattice, with and without --deterministic.
+//
+// The runs share the process, one world after the other: pools, buffers and schedulers belong to
+// the world (SimulationState), so a run starts from nothing the previous one left. Each run
+// writes, per frame, the bodies sorted by entity id to a temporary file; ids match between runs
+// since every run spawns the same way.
+//
+// --tolerance is the largest accepted absolute difference of a position or velocity component,
+// 0 requires bit-exact results. The default is 1e-3, or 0 with --deterministic
+// (GameState::deterministic). One JSON line per run; the exit code is 1 if any run diverged.
+
+struct BodyState
+{
+    uint64_t id;
+    float position[3];
+    float velocity[3];
+};
+
+// Simulation log goes to stderr so the JSON lines stay readable
+static void QuietLog(int msgType, const char* text, va_list args)
+{
+    if (msgType < LOG_WARNING)
+        return;
+
+    fprintf(stderr, "%s ", GetLogMsgTypeAsString(msgType));
+    vfprintf(stderr, text, args);
+    fprintf(stderr, "\n");
+}
+
+static bool MakeScenario(const LaunchOptions& options, Scenario& scenario)
+{
+    if (!options.scenarioPath.empty())
+    {
+        std::string error;
+        if (!LoadScenario(options.scenarioPath, scenario, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+        // SpawnScenario lays fluid out with SpawnFluidScene, which is not seeded either
+        if (scenario.mode == SimulationMode::Fluid)
+        {
+            fprintf(stderr, "Scenario '%s' is a fluid scene and not reproducible, use a bounce scenario\n", scenario.name.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    if (StressPattern pattern; ParseStressPattern(options.scene, pattern))
+    {
+        scenario = MakeStressScenario(pattern, options.entityCount);
+        return true;
+    }
+    if (options.scene == "uniform")
+    {
+        scenario.name = "uniform";
+        scenario.count = options.entityCount;
+        return true;
+    }
+
+    // bounce/fluid/churn draw from unseeded generators, two runs would never match
+    fprintf(stderr, "Scene '%s' is not reproducible, use --scenario or --scene cell|lattice|blob|uniform\n", options.scene.c_str());
+    return false;
+}
+
+// --- One configuration ---
+static bool RunConfiguration(const LaunchOptions& options, const Scenario& scenario, const std::string& dumpPath)
+{
+    flecs::world* world = CreateSimulationWorld();
+    SetSimulationThreads(*world, std::max(options.threads, 1));
+    world->import<Physics>(); // what is compared; no particles, render queries or stats
+
+    {
+        GameState& game_state = world->ensure<GameState>();
+        game_state.collisionSolver = options.solver;
+        game_state.broadphase = options.broadphase;
+        game_state.precision = options.precision;
+        game_state.dimensions = options.dimensions;
+        game_state.deterministic = options.deterministic;
+    }
+    SpawnScenario(*world, scenario);
+
+    flecs::query<const Position, const Velocity> bodies = world->query_builder<const Position, const Velocity>()
+        .without<Spark>()
+        .build();
+
+    std::ofstream out(dumpPath, std::ios::binary);
+    const int frames = scenario.frames > 0 ? scenario.frames : options.frames;
+    std::vector<BodyState> states;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        world->progress(1.0f / 60.0f);
+
+        states.clear();
+        bodies.each([&](flecs::entity e, const Position& p, const Velocity& v)
+        {
+            states.push_back({ e.id(), { p.value.x, p.value.y, p.value.z }, { v.value.x, v.value.y, v.value.z } });
+        });
+        std::sort(states.begin(), states.end(), [](const BodyState& a, const BodyState& b) { return a.id < b.id; });
+
+        const uint32_t count = static_cast<uint32_t>(states.size());
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(states.data()), static_cast<std::streamsize>(states.size() * sizeof(BodyState)));
+    }
+
+    delete world;
+    return static_cast<bool>(out);
+}
+
+// --- Run every configuration and compare ---
+static const char* PrecisionName(Precision precision)
+{
+    return precision == Precision::Double ? "double" : (precision == Precision::FixedContacts ? "fixed-contacts" : "float");
+}
+
+struct Configuration
+{
+    BroadphaseKind broadphase;
+    Precision precision;
+    int threads;
+    std::string dumpPath;
+
+    std::string Name() const
+    {
+        return std::string(broadphase == BroadphaseKind::SortedGrid ? "grid" : "hash") + "/"
+            + PrecisionName(precision) + "/" + std::to_string(threads) + "t";
+    }
+};
+
+static bool ReadFrame(std::ifstream& in, std::vector<BodyState>& states)
+{
+    uint32_t count = 0;
+    if (!in.read(reinterpret_cast<char*>(&count), sizeof(count)))
+        return false;
+    states.resize(count);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(states.data()), static_cast<std::streamsize>(count * sizeof(BodyState))));
+}
+
+// Largest component difference, or infinity when bit-exact is required and the bits differ
+static float ComponentError(const float* a, const float* b, float tolerance)
+{
+    if (tolerance <= 0.0f)
+        return std::memcmp(a, b, 3 * sizeof(float)) == 0 ? 0.0f : INFINITY;
+
+    float error = 0.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        error = std::max(error, std::fabs(a[i] - b[i]));
+    }
+    return std::isnan(error) ? INFINITY : error;
+}
+
+// Prints the run's JSON line; true when it stayed within tolerance on every frame
+static bool Compare(const Configuration& reference, const Configuration& run, float tolerance)
+{
+    std::ifstream expectedIn(reference.dumpPath, std::ios::binary);
+    std::ifstream actualIn(run.dumpPath, std::ios::binary);
+    std::vector<BodyState> expected;
+    std::vector<BodyState> actual;
+
+    int frame = 0;
+    float maxError = 0.0f;
+    while (ReadFrame(expectedIn, expected))
+    {
+        if (!ReadFrame(actualIn, actual))
+        {
+            printf("{\"run\":\"%s\",\"diverged_frame\":%d,\"reason\":\"run ended early\"}\n", run.Name().c_str(), frame);
+            return false;
+        }
+        if (actual.size() != expected.size())
+        {
+            printf("{\"run\":\"%s\",\"diverged_frame\":%d,\"reason\":\"%zu bodies, expected %zu\"}\n", run.Name().c_str(), frame, actual.size(), expected.size());
+            return false;
+        }
+
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            const BodyState& e = expected[i];
+            const BodyState& a = actual[i];
+            if (a.id != e.id)
+            {
+                printf("{\"run\":\"%s\",\"diverged_frame\":%d,\"reason\":\"entity %llu where %llu was expected\"}\n",
+                    run.Name().c_str(), frame, static_cast<unsigned long long>(a.id), static_cast<unsigned long long>(e.id));
+                return false;
+            }
+
+            const float positionError = ComponentError(a.position, e.position, tolerance);
+            const float velocityError = ComponentError(a.velocity, e.velocity, tolerance);
+            if (positionError > tolerance || velocityError > tolerance)
+            {
+                const bool position = positionError > tolerance;
+                const float* got = position ? a.position : a.velocity;
+                const float* want = position ? e.position : e.velocity;
+                printf("{\"run\":\"%s\",\"diverged_frame\":%d,\"entity\":%llu,\"field\":\"%s\",\"got\":[%.9g,%.9g,%.9g],\"expected\":[%.9g,%.9g,%.9g],\"max_error_before\":%.9g}\n",
+                    run.Name().c_str(), frame, static_cast<unsigned long long>(e.id), position ? "position" : "velocity",
+                    got[0], got[1], got[2], want[0], want[1], want[2], maxError);
+                return false;
+            }
+            maxError = std::max({ maxError, positionError, velocityError });
+        }
+        ++frame;
+    }
+
+    printf("{\"run\":\"%s\",\"frames\":%d,\"diverged_frame\":-1,\"max_error\":%.9g}\n", run.Name().c_str(), frame, maxError);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    // our own options, everything else goes to ParseLaunchOptions
+    float tolerance = -1.0f; // not given
+    std::vector<int> threadCounts = { 1, 2, 4, 8 };
+    std::vector<char*> forwarded = { argv[0] };
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--tolerance" && hasValue)
+        {
+            tolerance = std::max(static_cast<float>(std::atof(argv[++i])), 0.0f);
+        }
+        else if (arg == "--thread-counts" && hasValue)
+        {
+            threadCounts.clear();
+            for (const char* p = argv[++i]; *p; )
+            {
+                threadCounts.push_back(std::max(std::atoi(p), 1));
+                while (*p && *p != ',') ++p;
+                if (*p == ',') ++p;
+            }
+        }
+        else
+        {
+            forwarded.push_back(argv[i]);
+        }
+    }
+    const LaunchOptions options = ParseLaunchOptions(static_cast<int>(forwarded.size()), forwarded.data());
+    SetSimLogCallback(QuietLog);
+
+    Scenario scenario;
+    if (!MakeScenario(options, scenario))
+        return 1;
+    if (tolerance < 0.0f)
+        tolerance = options.deterministic ? 0.0f : 1e-3f;
+
+    // per precision: its reference first, then every other backend and thread count
+    const std::filesystem::path tempDir = std::filesystem::temp_directory_path();
+    std::vector<Configuration> runs;
+    for (Precision precision : { Precision::Float, Precision::Double, Precision::FixedContacts })
+    {
+        runs.push_back({ BroadphaseKind::HashBuckets, precision, 1 });
+        for (BroadphaseKind broadphase : { BroadphaseKind::HashBuckets, BroadphaseKind::SortedGrid })
+        {
+            for (int threads : threadCounts)
+            {
+                if (broadphase != BroadphaseKind::HashBuckets || threads != 1)
+                    runs.push_back({ broadphase, precision, threads });
+            }
+        }
+    }
+
+    const auto referenceOf = [&](const Configuration& run) -> size_t
+    {
+        for (size_t k = 0; k < runs.size(); ++k)
+        {
+            if (runs[k].broadphase == BroadphaseKind::HashBuckets && runs[k].precision == run.precision && runs[k].threads == 1)
+                return k;
+        }
+        return 0;
+    };
+    std::vector<bool> failed(runs.size(), false);
+
+    bool allMatch = true;
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        Configuration& run = runs[i];
+        run.dumpPath = (tempDir / ("myproject_diff_" + std::to_string(i) + ".bin")).string();
+        LaunchOptions runOptions = options;
+        runOptions.broadphase = run.broadphase;
+        runOptions.precision = run.precision;
+        runOptions.threads = run.threads;
+        const size_t reference = referenceOf(run);
+        if (failed[reference])
+        {
+            printf("{\"run\":\"%s\",\"reason\":\"no reference run\"}\n", run.Name().c_str());
+            continue; // the reference failure is already reported
+        }
+        if (!RunConfiguration(runOptions, scenario, run.dumpPath))
+        {
+            printf("{\"run\":\"%s\",\"reason\":\"run failed\"}\n", run.Name().c_str());
+            failed[i] = true;
+            allMatch = false;
+            continue;
+        }
+
+        if (reference != i)
+            allMatch = Compare(runs[reference], run, tolerance) && allMatch;
+        else
+            printf("{\"reference\":\"%s\",\"tolerance\":%.9g}\n", run.Name().c_str(), tolerance);
+        fflush(stdout);
+    }
+
+    for (const Configuration& run : runs)
+    {
+        std::error_code ignored;
+        std::filesystem::remove(run.dumpPath, ignored);
+    }
+    return allMatch ? 0 : 1;
+}
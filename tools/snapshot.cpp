@@ -0,0 +1,69 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+// --- World snapshot tool ---
+// MyProjectSnapshot <bounce|fluid> [--count N] [--frames N] [--out file.json]
+// Spawns a scene, steps it a fixed number of 60 Hz frames and writes the Flecs world as JSON,
+// for inspecting a scene or diffing two builds without starting the app.
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <bounce|fluid> [--count N] [--frames N] [--out file.json]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string scene = argv[1];
+    int count = 1000;
+    int frames = 60;
+    std::string out = "snapshot.json";
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--count")
+            count = std::max(std::atoi(argv[i + 1]), 0);
+        else if (arg == "--frames")
+            frames = std::max(std::atoi(argv[i + 1]), 0);
+        else if (arg == "--out")
+            out = argv[i + 1];
+        else
+            fprintf(stderr, "Ignoring unknown argument '%s'\n", arg.c_str());
+    }
+
+    // a headless server's set of modules: no particles, no render queries
+    flecs::world* world = CreateSimulationWorld();
+    world->import<Physics>();
+    world->import<Stats>();
+
+    if (scene == "bounce")
+    {
+        SpawnBounceScene(*world, count);
+    }
+    else if (scene == "fluid")
+    {
+        SpawnFluidScene(*world, count);
+    }
+    else
+    {
+        fprintf(stderr, "Unknown scene '%s'\n", scene.c_str());
+        delete world;
+        return 1;
+    }
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        world->progress(1.0f / 60.0f);
+    }
+
+    std::ofstream(out) << world->to_json().c_str();
+    printf("{\"scene\":\"%s\",\"frames\":%d,\"bodies\":%d,\"kinetic_energy\":%.6g,\"out\":\"%s\"}\n",
+        scene.c_str(), frames, GetSimulationState(*world).stats.bodies, GetSimulationState(*world).stats.kineticEnergy, out.c_str());
+
+    delete world;
+    return 0;
+}